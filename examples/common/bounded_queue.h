@@ -0,0 +1,136 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __BOUNDED_QUEUE_H__
+#define __BOUNDED_QUEUE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <deque>
+#include <utility>
+#include <mutex>
+#include <condition_variable>
+
+/* occupancy counters, sampled on every push/pop. */
+typedef struct _queue_stats
+{
+    size_t capacity;
+    size_t max_depth;
+    uint64_t depth_sum;       /* sum of the depth seen by every push/pop */
+    uint64_t samples;
+    uint64_t full_waits;      /* producer blocked on a full queue */
+    uint64_t empty_waits;     /* consumer blocked on an empty queue */
+} queue_stats;
+
+/*
+    Blocking FIFO with a fixed capacity, used to connect pipeline stages.
+    push() blocks while the queue is full, pop() blocks while it is empty.
+    After close() pushes fail and pop() drains what is left, then fails.
+*/
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity)
+        : capacity_(capacity > 0 ? capacity : 1), closed_(false)
+    {
+        reset_stats();
+    }
+
+    bool push(T item)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (items_.size() >= capacity_ && !closed_)
+        {
+            stats_.full_waits++;
+            not_full_.wait(lock, [this] { return items_.size() < capacity_ || closed_; });
+        }
+        if (closed_)
+        {
+            return false;
+        }
+        items_.push_back(std::move(item));
+        sample();
+        not_empty_.notify_one();
+        return true;
+    }
+
+    bool pop(T &item)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (items_.empty() && !closed_)
+        {
+            stats_.empty_waits++;
+            not_empty_.wait(lock, [this] { return !items_.empty() || closed_; });
+        }
+        if (items_.empty())
+        {
+            return false;
+        }
+        item = std::move(items_.front());
+        items_.pop_front();
+        sample();
+        not_full_.notify_one();
+        return true;
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_full_.notify_all();
+        not_empty_.notify_all();
+    }
+
+    queue_stats stats()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+private:
+    void reset_stats()
+    {
+        stats_.capacity = capacity_;
+        stats_.max_depth = 0;
+        stats_.depth_sum = 0;
+        stats_.samples = 0;
+        stats_.full_waits = 0;
+        stats_.empty_waits = 0;
+    }
+
+    void sample()
+    {
+        size_t depth = items_.size();
+        if (depth > stats_.max_depth)
+        {
+            stats_.max_depth = depth;
+        }
+        stats_.depth_sum += depth;
+        stats_.samples++;
+    }
+
+    BoundedQueue(const BoundedQueue &);
+    BoundedQueue &operator=(const BoundedQueue &);
+
+    size_t capacity_;
+    bool closed_;
+    std::deque<T> items_;
+    std::mutex mutex_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+    queue_stats stats_;
+};
+
+#endif /*__BOUNDED_QUEUE_H__*/
@@ -0,0 +1,264 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "dataset_pack.h"
+
+#define DATASET_PACK_MAGIC   0x50444b52 /* "RKDP" */
+#define DATASET_PACK_VERSION 1
+#define DATASET_PACK_ALIGN   8
+
+typedef struct _dataset_pack_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t count;
+    uint64_t index_offset;
+    uint64_t names_offset;
+    uint64_t names_size;
+} dataset_pack_header;
+
+typedef struct _dataset_pack_entry
+{
+    uint64_t offset;
+    uint32_t length;
+    int32_t label;
+    uint32_t name_offset;
+    uint32_t name_length;
+} dataset_pack_entry;
+
+DatasetPack::DatasetPack()
+    : base_(NULL), map_size_(0), count_(0), entries_(NULL), names_(NULL)
+{
+}
+
+DatasetPack::~DatasetPack()
+{
+    close();
+}
+
+int DatasetPack::open(const std::string &path)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        printf("open %s fail! %s\n", path.c_str(), strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(dataset_pack_header))
+    {
+        printf("%s is not a dataset pack\n", path.c_str());
+        ::close(fd);
+        return -1;
+    }
+    map_size_ = st.st_size;
+    void *addr = mmap(NULL, map_size_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+    {
+        printf("mmap %s fail! %s\n", path.c_str(), strerror(errno));
+        map_size_ = 0;
+        return -1;
+    }
+    base_ = (const uint8_t *)addr;
+
+    const dataset_pack_header *header = (const dataset_pack_header *)base_;
+    /* bounds are compared by subtraction, a corrupt header must not overflow them. */
+    if (header->magic != DATASET_PACK_MAGIC || header->version != DATASET_PACK_VERSION ||
+        header->index_offset > map_size_ ||
+        header->count > (map_size_ - header->index_offset) / sizeof(dataset_pack_entry) ||
+        header->names_offset > map_size_ || header->names_size > map_size_ - header->names_offset)
+    {
+        printf("%s is not a dataset pack or is truncated\n", path.c_str());
+        close();
+        return -1;
+    }
+    count_ = header->count;
+    entries_ = base_ + header->index_offset;
+    names_ = (const char *)base_ + header->names_offset;
+
+    /* check every entry once, name() and data() then never leave the mapping. */
+    const dataset_pack_entry *entries = (const dataset_pack_entry *)entries_;
+    for (size_t i = 0; i < count_; i++)
+    {
+        const dataset_pack_entry *e = entries + i;
+        if (e->name_offset > header->names_size || e->name_length > header->names_size - e->name_offset ||
+            e->offset > map_size_ || e->length > map_size_ - e->offset)
+        {
+            printf("%s: index entry %d is corrupt\n", path.c_str(), (int)i);
+            close();
+            return -1;
+        }
+    }
+
+    /* images are read front to back once: read ahead, and keep the index resident. */
+    size_t index_page = header->index_offset / getpagesize() * getpagesize();
+    madvise(addr, header->index_offset, MADV_SEQUENTIAL);
+    madvise((uint8_t *)addr + index_page, map_size_ - index_page, MADV_WILLNEED);
+    printf("dataset pack: %d images in %s\n", (int)count_, path.c_str());
+    return 0;
+}
+
+void DatasetPack::close()
+{
+    if (base_)
+    {
+        munmap((void *)base_, map_size_);
+        base_ = NULL;
+        map_size_ = 0;
+    }
+    count_ = 0;
+    entries_ = NULL;
+    names_ = NULL;
+}
+
+std::string DatasetPack::name(size_t index) const
+{
+    const dataset_pack_entry *e = (const dataset_pack_entry *)entries_ + index;
+    return std::string(names_ + e->name_offset, e->name_length);
+}
+
+int DatasetPack::label(size_t index) const
+{
+    return ((const dataset_pack_entry *)entries_)[index].label;
+}
+
+const uint8_t *DatasetPack::data(size_t index, size_t *length) const
+{
+    const dataset_pack_entry *e = (const dataset_pack_entry *)entries_ + index;
+    *length = e->length;
+    return base_ + e->offset;
+}
+
+std::vector<std::string> DatasetPack::names() const
+{
+    std::vector<std::string> result(count_);
+    for (size_t i = 0; i < count_; i++)
+    {
+        result[i] = name(i);
+    }
+    return result;
+}
+
+bool is_dataset_pack(const std::string &path)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+        return false;
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (fp == NULL)
+        return false;
+    uint32_t magic = 0;
+    bool ok = fread(&magic, sizeof(magic), 1, fp) == 1 && magic == DATASET_PACK_MAGIC;
+    fclose(fp);
+    return ok;
+}
+
+DatasetPackWriter::DatasetPackWriter()
+    : fp_(NULL), offset_(0)
+{
+}
+
+DatasetPackWriter::~DatasetPackWriter()
+{
+    if (fp_)
+        fclose(fp_);
+}
+
+int DatasetPackWriter::open(const std::string &path)
+{
+    fp_ = fopen(path.c_str(), "wb");
+    if (fp_ == NULL)
+    {
+        printf("fopen %s fail!\n", path.c_str());
+        return -1;
+    }
+    path_ = path;
+    /* the header is rewritten by finish(), a crashed pack has no valid magic. */
+    dataset_pack_header header;
+    memset(&header, 0, sizeof(header));
+    if (fwrite(&header, sizeof(header), 1, fp_) != 1)
+    {
+        printf("fwrite %s fail!\n", path.c_str());
+        return -1;
+    }
+    offset_ = sizeof(header);
+    entries_.clear();
+    names_.clear();
+    return 0;
+}
+
+int DatasetPackWriter::add(const std::string &name, int label, const uint8_t *data, size_t length)
+{
+    if (fwrite(data, 1, length, fp_) != length)
+    {
+        printf("fwrite %s fail!\n", path_.c_str());
+        return -1;
+    }
+    dataset_pack_entry e;
+    memset(&e, 0, sizeof(e));
+    e.offset = offset_;
+    e.length = length;
+    e.label = label;
+    e.name_offset = names_.size();
+    e.name_length = name.size();
+    entries_.insert(entries_.end(), (const uint8_t *)&e, (const uint8_t *)&e + sizeof(e));
+    names_ += name;
+    offset_ += length;
+    return 0;
+}
+
+int DatasetPackWriter::finish()
+{
+    /* keep the index 8 byte aligned for its 64-bit offsets. */
+    static const uint8_t padding[DATASET_PACK_ALIGN] = { 0 };
+    size_t pad = (DATASET_PACK_ALIGN - offset_ % DATASET_PACK_ALIGN) % DATASET_PACK_ALIGN;
+    if (fwrite(padding, 1, pad, fp_) != pad)
+    {
+        printf("fwrite %s fail!\n", path_.c_str());
+        return -1;
+    }
+    offset_ += pad;
+    dataset_pack_header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = DATASET_PACK_MAGIC;
+    header.version = DATASET_PACK_VERSION;
+    header.count = entries_.size() / sizeof(dataset_pack_entry);
+    header.index_offset = offset_;
+    header.names_offset = offset_ + entries_.size();
+    header.names_size = names_.size();
+    if (fwrite(entries_.data(), 1, entries_.size(), fp_) != entries_.size() ||
+        fwrite(names_.data(), 1, names_.size(), fp_) != names_.size() ||
+        fseek(fp_, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, fp_) != 1)
+    {
+        printf("fwrite %s fail!\n", path_.c_str());
+        return -1;
+    }
+    int ret = fclose(fp_);
+    fp_ = NULL;
+    if (ret != 0)
+    {
+        printf("fclose %s fail!\n", path_.c_str());
+        return -1;
+    }
+    return 0;
+}
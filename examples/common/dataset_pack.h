@@ -0,0 +1,91 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __DATASET_PACK_H__
+#define __DATASET_PACK_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+/*
+    Single file dataset: encoded images stored back to back, followed by an
+    index (offset, length, label, name) and the image names.
+
+        header | image data ... | index entries | names
+
+    A directory of 50k JPEGs becomes one large sequential read instead of a
+    readdir scan and an open/read per image, and a single file is easy to
+    copy onto a board. Images keep their encoded form, decoding still runs
+    on the decoder pool.
+*/
+class DatasetPack
+{
+public:
+    DatasetPack();
+    ~DatasetPack();
+
+    /* map path, 0 on success. */
+    int open(const std::string &path);
+    void close();
+
+    bool is_open() const { return base_ != NULL; }
+    size_t size() const { return count_; }
+    std::string name(size_t index) const;
+    /* ground truth stored at pack time, -1 if none. */
+    int label(size_t index) const;
+    /* encoded image bytes of index, inside the mapping. */
+    const uint8_t *data(size_t index, size_t *length) const;
+    /* image names in pack order. */
+    std::vector<std::string> names() const;
+
+private:
+    DatasetPack(const DatasetPack &);
+    DatasetPack &operator=(const DatasetPack &);
+
+    const uint8_t *base_;
+    size_t map_size_;
+    size_t count_;
+    const void *entries_;
+    const char *names_;
+};
+
+/* true if path is a regular file starting with the pack magic. */
+bool is_dataset_pack(const std::string &path);
+
+/* streams images into a new pack, the index is written by finish(). */
+class DatasetPackWriter
+{
+public:
+    DatasetPackWriter();
+    ~DatasetPackWriter();
+
+    int open(const std::string &path);
+    int add(const std::string &name, int label, const uint8_t *data, size_t length);
+    int finish();
+
+private:
+    DatasetPackWriter(const DatasetPackWriter &);
+    DatasetPackWriter &operator=(const DatasetPackWriter &);
+
+    FILE *fp_;
+    std::string path_;
+    uint64_t offset_;
+    std::vector<uint8_t> entries_;
+    std::string names_;
+};
+
+#endif /*__DATASET_PACK_H__*/
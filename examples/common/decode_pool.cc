@@ -0,0 +1,266 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "decode_pool.h"
+#include "trace.h"
+#include "jpeg_scale.h"
+
+/* jobs queued per worker before submit() blocks. */
+#define DECODE_JOBS_PER_WORKER 4
+
+bool read_file(const std::string &filename, std::vector<uchar> &data)
+{
+    FILE *fp = fopen(filename.c_str(), "rb");
+    if (fp == NULL)
+    {
+        return false;
+    }
+    fseek(fp, 0, SEEK_END);
+    long len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    data.resize(len > 0 ? len : 0);
+    bool ok = len > 0 && fread(data.data(), 1, len, fp) == (size_t)len;
+    fclose(fp);
+    return ok;
+}
+
+int get_online_cpus()
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+DecodePool::DecodePool(int threads, BoundedQueue<DecodedImage> *out, StageStats *stats, int read_flags)
+    : out_(out), stats_(stats), read_flags_(read_flags), reduce_width_(0), reduce_height_(0),
+      reduce_max_factor_(1), next_(0), pending_(0), done_(false), cancelled_(false)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        scaled_[i] = 0;
+    }
+    if (threads <= 0)
+    {
+        threads = get_online_cpus();
+    }
+    for (int i = 0; i < threads; i++)
+    {
+        workers_.push_back(new Worker());
+    }
+    capacity_ = threads * DECODE_JOBS_PER_WORKER;
+}
+
+DecodePool::~DecodePool()
+{
+    cancel();
+    finish();
+    for (size_t i = 0; i < workers_.size(); i++)
+    {
+        delete workers_[i];
+    }
+}
+
+void DecodePool::start()
+{
+    for (size_t i = 0; i < workers_.size(); i++)
+    {
+        workers_[i]->thread = std::thread(&DecodePool::worker_loop, this, (int)i);
+    }
+}
+
+bool DecodePool::submit(DecodeJob job)
+{
+    Worker *w;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        space_cv_.wait(lock, [this] { return pending_ < (int)capacity_ || cancelled_; });
+        if (cancelled_)
+        {
+            return false;
+        }
+        next_ = (next_ + 1) % workers_.size();
+        w = workers_[next_];
+    }
+    {
+        std::lock_guard<std::mutex> lock(w->mutex);
+        w->jobs.push_back(std::move(job));
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_++;
+    }
+    work_cv_.notify_one();
+    return true;
+}
+
+bool DecodePool::take(int id, DecodeJob &job)
+{
+    int n = (int)workers_.size();
+    {
+        Worker *self = workers_[id];
+        std::lock_guard<std::mutex> lock(self->mutex);
+        if (!self->jobs.empty())
+        {
+            job = std::move(self->jobs.front());
+            self->jobs.pop_front();
+            return true;
+        }
+    }
+    for (int k = 1; k < n; k++)
+    {
+        Worker *victim = workers_[(id + k) % n];
+        std::lock_guard<std::mutex> lock(victim->mutex);
+        if (!victim->jobs.empty())
+        {
+            job = std::move(victim->jobs.back());
+            victim->jobs.pop_back();
+            workers_[id]->stolen++;
+            return true;
+        }
+    }
+    return false;
+}
+
+void DecodePool::decode(DecodeJob &job, DecodedImage &out)
+{
+    out.index = job.index;
+    out.name = job.name;
+    if (job.data.empty() && job.mapped == NULL)
+    {
+        TraceScope trace("read", job.index);
+        if (!read_file(job.path, job.data))
+        {
+            printf("read %s fail!\n", job.path.c_str());
+            return;
+        }
+    }
+    {
+        TraceScope trace("imdecode", job.index);
+        const uchar *data = job.mapped ? job.mapped : job.data.data();
+        size_t size = job.mapped ? job.mapped_size : job.data.size();
+        if (size == 0)
+        {
+            printf("cv::imdecode %s fail! empty file\n", job.path.c_str());
+            return;
+        }
+        int flags = read_flags_;
+        int factor = 1;
+        int width, height;
+        if (reduce_max_factor_ > 1 && jpeg_frame_size(data, size, &width, &height))
+        {
+            factor = jpeg_scale_factor(width, height, reduce_width_, reduce_height_, reduce_max_factor_);
+            flags = jpeg_reduced_read_flags(factor);
+        }
+        out.img = cv::imdecode(cv::Mat(1, (int)size, CV_8UC1, (void *)data), flags);
+        scaled_[factor == 8 ? 3 : factor / 2]++;
+    }
+    if (!out.img.data)
+    {
+        printf("cv::imdecode %s fail!\n", job.path.c_str());
+        return;
+    }
+    if (transform_)
+    {
+        transform_(out);
+    }
+}
+
+void DecodePool::worker_loop(int id)
+{
+    trace_thread_name("decode " + std::to_string(id));
+    while (true)
+    {
+        DecodeJob job;
+        if (take(id, job))
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                pending_--;
+            }
+            space_cv_.notify_one();
+            if (cancelled_)
+            {
+                continue;
+            }
+            int64_t t0 = get_time_us();
+            DecodedImage out;
+            decode(job, out);
+            workers_[id]->decoded++;
+            if (stats_)
+            {
+                stats_->add(get_time_us() - t0);
+            }
+            out_->push(std::move(out));
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        work_cv_.wait(lock, [this] { return pending_ > 0 || done_; });
+        if (done_ && pending_ <= 0)
+        {
+            break;
+        }
+    }
+}
+
+void DecodePool::finish()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        done_ = true;
+    }
+    work_cv_.notify_all();
+    for (size_t i = 0; i < workers_.size(); i++)
+    {
+        if (workers_[i]->thread.joinable())
+        {
+            workers_[i]->thread.join();
+        }
+    }
+}
+
+void DecodePool::cancel()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cancelled_ = true;
+        done_ = true;
+    }
+    space_cv_.notify_all();
+    work_cv_.notify_all();
+}
+
+void DecodePool::set_reduced_decode(int width, int height, int max_factor)
+{
+    reduce_width_ = width;
+    reduce_height_ = height;
+    reduce_max_factor_ = max_factor > 1 ? max_factor : 1;
+}
+
+void DecodePool::print_report()
+{
+    printf("decode pool: %d workers\n", (int)workers_.size());
+    if (reduce_max_factor_ > 1)
+    {
+        printf("  reduced decode (max 1/%d): 1/1=%llu 1/2=%llu 1/4=%llu 1/8=%llu\n", reduce_max_factor_,
+               (unsigned long long)scaled_[0], (unsigned long long)scaled_[1],
+               (unsigned long long)scaled_[2], (unsigned long long)scaled_[3]);
+    }
+    for (size_t i = 0; i < workers_.size(); i++)
+    {
+        printf("  worker %zu: decoded=%llu stolen=%llu\n", i,
+               (unsigned long long)workers_[i]->decoded, (unsigned long long)workers_[i]->stolen);
+    }
+}
@@ -0,0 +1,140 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __DECODE_POOL_H__
+#define __DECODE_POOL_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/imgcodecs.hpp"
+
+#include "bounded_queue.h"
+#include "stage_stats.h"
+
+/*
+    one image to decode. mapped points at encoded bytes owned by the caller
+    (e.g. a dataset pack), else when data is empty the worker reads path itself.
+*/
+struct DecodeJob
+{
+    DecodeJob() : index(0), mapped(NULL), mapped_size(0) {}
+    int index;
+    std::string name;
+    std::string path;
+    std::vector<uchar> data;
+    const uchar *mapped;
+    size_t mapped_size;
+};
+
+/* decode result, img is empty when reading or decoding failed. */
+struct DecodedImage
+{
+    DecodedImage() : index(0), rgb(false) {}
+    int index;
+    std::string name;
+    cv::Mat img;
+    bool rgb;       /* BGR from the decoder until resized and converted to RGB */
+};
+
+/* read a whole file into data, return false on error. */
+bool read_file(const std::string &filename, std::vector<uchar> &data);
+
+/* number of online cpus, used when the pool size is not given. */
+int get_online_cpus();
+
+/*
+    JPEG decode thread pool with work stealing.
+
+    Jobs are dealt round-robin into per-worker deques. A worker takes from
+    the front of its own deque and, once empty, steals from the back of the
+    others, so one large JPEG only delays the worker decoding it. Decoded
+    images are pushed to the output queue in completion order; callers that
+    need the original order reorder by DecodedImage::index.
+*/
+class DecodePool
+{
+public:
+    /* called on the worker after decoding, e.g. to resize in parallel. */
+    typedef std::function<void(DecodedImage &)> Transform;
+
+    /* threads <= 0 sizes the pool from the online cpu count. */
+    DecodePool(int threads, BoundedQueue<DecodedImage> *out, StageStats *stats = NULL,
+               int read_flags = cv::IMREAD_COLOR);
+    ~DecodePool();
+
+    void set_transform(const Transform &transform) { transform_ = transform; }
+    /*
+        decode JPEGs at 1/2, 1/4 or 1/8 size (at most max_factor) when the
+        result still covers width x height, the transform finishes the resize.
+    */
+    void set_reduced_decode(int width, int height, int max_factor);
+    int threads() const { return (int)workers_.size(); }
+
+    void start();
+    /* queue a job, blocks while too many jobs are pending. */
+    bool submit(DecodeJob job);
+    /* wait until every submitted job is decoded, then stop the workers. */
+    void finish();
+    /* drop pending jobs, safe to call from any thread; finish() still joins. */
+    void cancel();
+
+    void print_report();
+
+private:
+    struct Worker
+    {
+        Worker() : decoded(0), stolen(0) {}
+        std::mutex mutex;
+        std::deque<DecodeJob> jobs;
+        std::thread thread;
+        uint64_t decoded;
+        uint64_t stolen;
+    };
+
+    bool take(int id, DecodeJob &job);
+    void worker_loop(int id);
+    void decode(DecodeJob &job, DecodedImage &out);
+
+    DecodePool(const DecodePool &);
+    DecodePool &operator=(const DecodePool &);
+
+    std::vector<Worker *> workers_;
+    BoundedQueue<DecodedImage> *out_;
+    StageStats *stats_;
+    int read_flags_;
+    int reduce_width_;
+    int reduce_height_;
+    int reduce_max_factor_;         /* 1 disables reduced decoding */
+    std::atomic<uint64_t> scaled_[4];   /* images decoded at 1/1, 1/2, 1/4, 1/8 */
+    Transform transform_;
+    size_t capacity_;
+    size_t next_;
+    int pending_;
+    bool done_;
+    std::atomic<bool> cancelled_;
+    std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::condition_variable space_cv_;
+};
+
+#endif /*__DECODE_POOL_H__*/
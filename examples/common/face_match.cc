@@ -0,0 +1,259 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include "face_match.h"
+#include "stage_stats.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+float feature_dot(const float *a, const float *b, uint32_t dim)
+{
+    uint32_t i = 0;
+    float sum = 0;
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    /* two accumulators hide the multiply-add latency */
+    float32x4_t acc0 = vdupq_n_f32(0);
+    float32x4_t acc1 = vdupq_n_f32(0);
+    for (; i + 8 <= dim; i += 8)
+    {
+        acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+        acc1 = vmlaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+    float32x4_t acc = vaddq_f32(acc0, acc1);
+    float32x2_t pair = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+    sum = vget_lane_f32(vpadd_f32(pair, pair), 0);
+#endif
+    for (; i < dim; i++)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+FeatureMatrix::FeatureMatrix()
+    : data_(NULL), dim_(0), stride_(0), count_(0)
+{
+}
+
+int FeatureMatrix::load(const FeatureStore &store)
+{
+    if (!store.is_open())
+        return -1;
+    dim_ = store.dim();
+    stride_ = (dim_ + 3) & ~3u;
+    count_ = store.count();
+    buffer_.assign(count_ * stride_ + 4, 0.0f);
+    data_ = buffer_.data();
+    while ((uintptr_t)data_ & 15)
+        data_++;
+    for (size_t n = 0; n < count_; n++)
+    {
+        float *r = data_ + n * stride_;
+        store.row_float(n, r);
+        if (store.normalized())
+            continue;
+        float norm = sqrtf(feature_dot(r, r, dim_));
+        float inv = norm > 0 ? 1.0f / norm : 0.0f;
+        for (uint32_t i = 0; i < dim_; i++)
+            r[i] *= inv;
+    }
+    return 0;
+}
+
+int load_verify_pairs(const std::string &path, const std::map<std::string, uint32_t> &index,
+                      std::vector<VerifyPair> *pairs, int *skipped)
+{
+    std::ifstream in(path);
+    if (!in.is_open())
+    {
+        printf("open %s fail!\n", path.c_str());
+        return -1;
+    }
+    std::string line;
+    *skipped = 0;
+    while (std::getline(in, line))
+    {
+        std::istringstream fields(line);
+        std::string a, b;
+        int same;
+        if (!(fields >> a >> b >> same))
+            continue;
+        std::map<std::string, uint32_t>::const_iterator ia = index.find(a);
+        std::map<std::string, uint32_t>::const_iterator ib = index.find(b);
+        if (ia == index.end() || ib == index.end())
+        {
+            (*skipped)++;
+            continue;
+        }
+        VerifyPair pair = { ia->second, ib->second, same != 0, 0.0f };
+        pairs->push_back(pair);
+    }
+    return 0;
+}
+
+static bool score_greater(const VerifyPair &x, const VerifyPair &y)
+{
+    return x.score > y.score;
+}
+
+int verify_pairs(const FeatureMatrix &features, std::vector<VerifyPair> &pairs, VerifyReport *report)
+{
+    report->positives = 0;
+    report->negatives = 0;
+    report->best_threshold = 0;
+    report->best_accuracy = 0;
+    report->auc = 0;
+    report->roc.clear();
+    for (size_t i = 0; i < pairs.size(); i++)
+    {
+        pairs[i].score = features.cosine(pairs[i].a, pairs[i].b);
+        if (pairs[i].same)
+            report->positives++;
+        else
+            report->negatives++;
+    }
+    if (report->positives == 0 || report->negatives == 0)
+    {
+        printf("verification needs both matching and non-matching pairs\n");
+        return -1;
+    }
+
+    /*
+        lowering the threshold past each score in descending order accepts
+        one more pair, so TAR and FAR of every threshold fall out of a
+        running count: no per-threshold pass over the pairs.
+    */
+    std::sort(pairs.begin(), pairs.end(), score_greater);
+    int tp = 0, fp = 0;
+    double prev_tar = 0, prev_far = 0;
+    int total = report->positives + report->negatives;
+    /* rejecting every pair is an operating point too, it wins on negative heavy lists */
+    report->best_accuracy = (double)report->negatives / total;
+    report->best_threshold = nextafterf(pairs[0].score, FLT_MAX);
+    for (size_t i = 0; i < pairs.size(); i++)
+    {
+        if (pairs[i].same)
+            tp++;
+        else
+            fp++;
+        /* only a threshold between two distinct scores is an operating point */
+        if (i + 1 < pairs.size() && pairs[i + 1].score == pairs[i].score)
+            continue;
+        RocPoint point;
+        point.threshold = pairs[i].score;
+        point.tar = (double)tp / report->positives;
+        point.far = (double)fp / report->negatives;
+        report->roc.push_back(point);
+        report->auc += (point.far - prev_far) * (point.tar + prev_tar) / 2;
+        prev_tar = point.tar;
+        prev_far = point.far;
+        double accuracy = (double)(tp + report->negatives - fp) / total;
+        if (accuracy > report->best_accuracy)
+        {
+            report->best_accuracy = accuracy;
+            report->best_threshold = point.threshold;
+        }
+    }
+    return 0;
+}
+
+double tar_at_far(const VerifyReport &report, double far)
+{
+    if (report.negatives * far < 1.0)
+        return -1;
+    double tar = 0;
+    for (size_t i = 0; i < report.roc.size() && report.roc[i].far <= far; i++)
+        tar = report.roc[i].tar;
+    return tar;
+}
+
+void print_verify_report(const VerifyReport &report)
+{
+    printf("===========verification result============\n");
+    printf("pairs: %d matching, %d non-matching\n", report.positives, report.negatives);
+    printf("best accuracy: %.2f%% at threshold %.4f\n", report.best_accuracy * 100, report.best_threshold);
+    printf("ROC AUC: %.5f\n", report.auc);
+    for (int i = 0; i < VERIFY_FAR_POINTS; i++)
+    {
+        double tar = tar_at_far(report, VERIFY_FAR_TARGETS[i]);
+        if (tar < 0)
+            printf("TAR@FAR=%g: n/a, needs %.0f non-matching pairs\n", VERIFY_FAR_TARGETS[i], 1.0 / VERIFY_FAR_TARGETS[i]);
+        else
+            printf("TAR@FAR=%g: %.2f%%\n", VERIFY_FAR_TARGETS[i], tar * 100);
+    }
+    printf("=========================================\n");
+}
+
+int write_roc(const std::string &path, const VerifyReport &report)
+{
+    FILE *fp = fopen(path.c_str(), "w");
+    if (fp == NULL)
+    {
+        printf("open %s fail!\n", path.c_str());
+        return -1;
+    }
+    fprintf(fp, "far,tar,threshold\n");
+    for (size_t i = 0; i < report.roc.size(); i++)
+        fprintf(fp, "%.8g,%.8g,%.6f\n", report.roc[i].far, report.roc[i].tar, report.roc[i].threshold);
+    return fclose(fp) == 0 ? 0 : -1;
+}
+
+int verify_store(const std::string &store_path, const std::vector<std::string> &names,
+                 const std::string &pairs_path, const std::string &roc_path)
+{
+    FeatureStore store;
+    if (store.open(store_path) != 0)
+        return -1;
+    if (store.count() != names.size())
+    {
+        printf("%s holds %d features for %d images\n", store_path.c_str(), (int)store.count(), (int)names.size());
+        return -1;
+    }
+    int64_t t0 = get_time_us();
+    FeatureMatrix features;
+    if (features.load(store) != 0)
+        return -1;
+    store.close();
+    int64_t t1 = get_time_us();
+
+    std::map<std::string, uint32_t> index;
+    for (size_t n = 0; n < names.size(); n++)
+        index[names[n]] = n;
+    std::vector<VerifyPair> pairs;
+    int skipped = 0;
+    if (load_verify_pairs(pairs_path, index, &pairs, &skipped) != 0)
+        return -1;
+    if (skipped > 0)
+        printf("%d pairs name images without a feature, skipped\n", skipped);
+
+    int64_t t2 = get_time_us();
+    VerifyReport report;
+    if (verify_pairs(features, pairs, &report) != 0)
+        return -1;
+    int64_t t3 = get_time_us();
+    printf("verify: %d x %u features loaded in %.1f ms, %d pairs scored and ranked in %.1f ms\n",
+           (int)features.count(), features.dim(), (t1 - t0) / 1000.0, (int)pairs.size(), (t3 - t2) / 1000.0);
+    print_verify_report(report);
+    if (!roc_path.empty() && write_roc(roc_path, report) != 0)
+        return -1;
+    return 0;
+}
@@ -0,0 +1,115 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __FACE_MATCH_H__
+#define __FACE_MATCH_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "feature_store.h"
+
+/* FAR operating points reported by the verification. */
+#define VERIFY_FAR_POINTS 3
+static const double VERIFY_FAR_TARGETS[VERIFY_FAR_POINTS] = { 1e-3, 1e-4, 1e-6 };
+
+/* dot product of two float vectors, NEON where available. */
+float feature_dot(const float *a, const float *b, uint32_t dim);
+
+/*
+    Features of a store as an L2 normalised float matrix in memory, so the
+    cosine similarity of two images is one dot product. fp16 stores are
+    widened once at load time. Rows are padded to a multiple of 4 floats
+    and 16 byte aligned for the vector loads.
+*/
+class FeatureMatrix
+{
+public:
+    FeatureMatrix();
+
+    int load(const FeatureStore &store);
+
+    uint32_t dim() const { return dim_; }
+    uint32_t stride() const { return stride_; }
+    size_t count() const { return count_; }
+    const float *row(size_t index) const { return data_ + index * stride_; }
+
+    float cosine(size_t a, size_t b) const { return feature_dot(row(a), row(b), dim_); }
+
+private:
+    std::vector<float> buffer_;
+    float *data_;
+    uint32_t dim_;
+    uint32_t stride_;
+    size_t count_;
+};
+
+/*
+    1:1 verification. A pair is two images and whether they show the same
+    identity; its score is their cosine similarity.
+*/
+struct VerifyPair
+{
+    uint32_t a;
+    uint32_t b;
+    bool same;
+    float score;
+};
+
+struct RocPoint
+{
+    float threshold;    /* pairs scoring >= threshold are accepted */
+    double tar;
+    double far;
+};
+
+struct VerifyReport
+{
+    int positives;
+    int negatives;
+    float best_threshold;
+    double best_accuracy;
+    double auc;
+    std::vector<RocPoint> roc;      /* one point per distinct score, far ascending */
+};
+
+/*
+    read "<image a> <image b> <1|0>" lines, names are looked up in index
+    (image name to feature row). Unknown names are counted in *skipped.
+*/
+int load_verify_pairs(const std::string &path, const std::map<std::string, uint32_t> &index,
+                      std::vector<VerifyPair> *pairs, int *skipped);
+
+/* score every pair, then derive the ROC with a single sort of the scores. */
+int verify_pairs(const FeatureMatrix &features, std::vector<VerifyPair> &pairs, VerifyReport *report);
+
+/* highest TAR whose FAR does not exceed far, -1 if there are too few negatives to measure it. */
+double tar_at_far(const VerifyReport &report, double far);
+
+void print_verify_report(const VerifyReport &report);
+/* ROC as "far,tar,threshold" lines. */
+int write_roc(const std::string &path, const VerifyReport &report);
+
+/*
+    the whole verification of a store whose row n is the feature of
+    names[n]: load, score the pairs file, print the report and write the
+    ROC to roc_path when it is not empty.
+*/
+int verify_store(const std::string &store_path, const std::vector<std::string> &names,
+                 const std::string &pairs_path, const std::string &roc_path);
+
+#endif /*__FACE_MATCH_H__*/
@@ -0,0 +1,452 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <thread>
+
+#include "face_search.h"
+#include "face_match.h"
+#include "stage_stats.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+/* store row converted to dim floats, scaled to unit length. returns false for a zero row. */
+static bool load_unit_row(const FeatureStore &store, size_t index, float *out)
+{
+    uint32_t dim = store.dim();
+    store.row_float(index, out);
+    if (store.normalized())
+        return true;
+    float norm = sqrtf(feature_dot(out, out, dim));
+    float inv = norm > 0 ? 1.0f / norm : 0.0f;
+    for (uint32_t i = 0; i < dim; i++)
+        out[i] *= inv;
+    return norm > 0;
+}
+
+Fp32Block::Fp32Block()
+    : data_(NULL), dim_(0), stride_(0), count_(0)
+{
+}
+
+void Fp32Block::resize(uint32_t dim, size_t count)
+{
+    dim_ = dim;
+    stride_ = (dim + 3) & ~3u;
+    count_ = count;
+    if (buffer_.size() < count * stride_ + 4)
+        buffer_.assign(count * stride_ + 4, 0.0f);
+    data_ = buffer_.data();
+    while ((uintptr_t)data_ & 15)
+        data_++;
+}
+
+void Fp32Block::convert(const FeatureStore &store, size_t first, size_t begin, size_t end)
+{
+    /* only dim values are written, the padding stays zero */
+    for (size_t n = begin; n < end; n++)
+        load_unit_row(store, first + n, data_ + n * stride_);
+}
+
+Int8Block::Int8Block()
+    : data_(NULL), dim_(0), stride_(0), count_(0)
+{
+}
+
+void Int8Block::resize(uint32_t dim, size_t count)
+{
+    dim_ = dim;
+    stride_ = (dim + 15) & ~15u;
+    count_ = count;
+    if (buffer_.size() < count * stride_ + 16)
+        buffer_.assign(count * stride_ + 16, 0);
+    if (scales_.size() < count)
+        scales_.resize(count);
+    data_ = buffer_.data();
+    while ((uintptr_t)data_ & 15)
+        data_++;
+}
+
+void Int8Block::convert(const FeatureStore &store, size_t first, size_t begin, size_t end)
+{
+    std::vector<float> r(dim_);
+    for (size_t n = begin; n < end; n++)
+    {
+        int8_t *out = data_ + n * stride_;
+        float peak = 0;
+        if (load_unit_row(store, first + n, r.data()))
+        {
+            for (uint32_t i = 0; i < dim_; i++)
+                peak = std::max(peak, fabsf(r[i]));
+        }
+        if (peak <= 0)
+        {
+            memset(out, 0, dim_);
+            scales_[n] = 0;
+            continue;
+        }
+        float q = 127.0f / peak;
+        for (uint32_t i = 0; i < dim_; i++)
+            out[i] = (int8_t)lrintf(r[i] * q);
+        scales_[n] = peak / 127.0f;
+    }
+}
+
+/*-------------------------------------------
+              Similarity kernels
+-------------------------------------------*/
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+static inline float hsum_f32(float32x4_t v)
+{
+    float32x2_t s = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+    return vget_lane_f32(vpadd_f32(s, s), 0);
+}
+
+static inline int32_t hsum_s32(int32x4_t v)
+{
+    int32x2_t s = vadd_s32(vget_low_s32(v), vget_high_s32(v));
+    return vget_lane_s32(vpadd_s32(s, s), 0);
+}
+
+static inline float32x4_t mla_f32(float32x4_t acc, float32x4_t a, float32x4_t b)
+{
+#if defined(__aarch64__)
+    return vfmaq_f32(acc, a, b);
+#else
+    return vmlaq_f32(acc, a, b);
+#endif
+}
+
+/* acc += dot products of 16 int8 pairs, folded into four lanes. */
+static inline int32x4_t dot_s8(int32x4_t acc, int8x16_t a, int8x16_t b)
+{
+#if defined(__ARM_FEATURE_DOTPROD)
+    return vdotq_s32(acc, a, b);
+#else
+    /* |q| <= 127, so two products fit an int16 lane before widening */
+    int16x8_t prod = vmull_s8(vget_low_s8(a), vget_low_s8(b));
+    prod = vmlal_s8(prod, vget_high_s8(a), vget_high_s8(b));
+    return vpadalq_s16(acc, prod);
+#endif
+}
+#endif
+
+
+static inline float row_dot(const Fp32Block &a, size_t i, const Fp32Block &b, size_t j)
+{
+    return feature_dot(a.row(i), b.row(j), a.stride());
+}
+
+static inline float row_dot(const Int8Block &a, size_t i, const Int8Block &b, size_t j)
+{
+    const int8_t *x = a.row(i);
+    const int8_t *y = b.row(j);
+    int32_t sum = 0;
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    int32x4_t acc = vdupq_n_s32(0);
+    for (uint32_t k = 0; k < a.stride(); k += 16)
+        acc = dot_s8(acc, vld1q_s8(x + k), vld1q_s8(y + k));
+    sum = hsum_s32(acc);
+#else
+    for (uint32_t k = 0; k < a.dim(); k++)
+        sum += x[k] * y[k];
+#endif
+    return sum * a.scale(i) * b.scale(j);
+}
+
+/*
+    scores of probe rows p..p+3 against gallery rows g..g+3 into out (row
+    length ld). Every loaded vector is used four times, which is what makes
+    the tile compute bound instead of load bound.
+*/
+static void dot_4x4(const Fp32Block &pb, size_t p, const Fp32Block &gb, size_t g, float *out, size_t ld)
+{
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    const float *p0 = pb.row(p), *p1 = pb.row(p + 1), *p2 = pb.row(p + 2), *p3 = pb.row(p + 3);
+    const float *g0 = gb.row(g), *g1 = gb.row(g + 1), *g2 = gb.row(g + 2), *g3 = gb.row(g + 3);
+    float32x4_t z = vdupq_n_f32(0);
+    float32x4_t a00 = z, a01 = z, a02 = z, a03 = z;
+    float32x4_t a10 = z, a11 = z, a12 = z, a13 = z;
+    float32x4_t a20 = z, a21 = z, a22 = z, a23 = z;
+    float32x4_t a30 = z, a31 = z, a32 = z, a33 = z;
+    /* rows are zero padded to the stride */
+    for (uint32_t k = 0; k < pb.stride(); k += 4)
+    {
+        float32x4_t y0 = vld1q_f32(g0 + k), y1 = vld1q_f32(g1 + k);
+        float32x4_t y2 = vld1q_f32(g2 + k), y3 = vld1q_f32(g3 + k);
+        float32x4_t x = vld1q_f32(p0 + k);
+        a00 = mla_f32(a00, x, y0); a01 = mla_f32(a01, x, y1); a02 = mla_f32(a02, x, y2); a03 = mla_f32(a03, x, y3);
+        x = vld1q_f32(p1 + k);
+        a10 = mla_f32(a10, x, y0); a11 = mla_f32(a11, x, y1); a12 = mla_f32(a12, x, y2); a13 = mla_f32(a13, x, y3);
+        x = vld1q_f32(p2 + k);
+        a20 = mla_f32(a20, x, y0); a21 = mla_f32(a21, x, y1); a22 = mla_f32(a22, x, y2); a23 = mla_f32(a23, x, y3);
+        x = vld1q_f32(p3 + k);
+        a30 = mla_f32(a30, x, y0); a31 = mla_f32(a31, x, y1); a32 = mla_f32(a32, x, y2); a33 = mla_f32(a33, x, y3);
+    }
+    out[0] = hsum_f32(a00); out[1] = hsum_f32(a01); out[2] = hsum_f32(a02); out[3] = hsum_f32(a03);
+    out += ld;
+    out[0] = hsum_f32(a10); out[1] = hsum_f32(a11); out[2] = hsum_f32(a12); out[3] = hsum_f32(a13);
+    out += ld;
+    out[0] = hsum_f32(a20); out[1] = hsum_f32(a21); out[2] = hsum_f32(a22); out[3] = hsum_f32(a23);
+    out += ld;
+    out[0] = hsum_f32(a30); out[1] = hsum_f32(a31); out[2] = hsum_f32(a32); out[3] = hsum_f32(a33);
+#else
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++)
+            out[i * ld + j] = row_dot(pb, p + i, gb, g + j);
+#endif
+}
+
+static void dot_4x4(const Int8Block &pb, size_t p, const Int8Block &gb, size_t g, float *out, size_t ld)
+{
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    const int8_t *p0 = pb.row(p), *p1 = pb.row(p + 1), *p2 = pb.row(p + 2), *p3 = pb.row(p + 3);
+    const int8_t *g0 = gb.row(g), *g1 = gb.row(g + 1), *g2 = gb.row(g + 2), *g3 = gb.row(g + 3);
+    int32x4_t z = vdupq_n_s32(0);
+    int32x4_t a00 = z, a01 = z, a02 = z, a03 = z;
+    int32x4_t a10 = z, a11 = z, a12 = z, a13 = z;
+    int32x4_t a20 = z, a21 = z, a22 = z, a23 = z;
+    int32x4_t a30 = z, a31 = z, a32 = z, a33 = z;
+    for (uint32_t k = 0; k < pb.stride(); k += 16)
+    {
+        int8x16_t y0 = vld1q_s8(g0 + k), y1 = vld1q_s8(g1 + k);
+        int8x16_t y2 = vld1q_s8(g2 + k), y3 = vld1q_s8(g3 + k);
+        int8x16_t x = vld1q_s8(p0 + k);
+        a00 = dot_s8(a00, x, y0); a01 = dot_s8(a01, x, y1); a02 = dot_s8(a02, x, y2); a03 = dot_s8(a03, x, y3);
+        x = vld1q_s8(p1 + k);
+        a10 = dot_s8(a10, x, y0); a11 = dot_s8(a11, x, y1); a12 = dot_s8(a12, x, y2); a13 = dot_s8(a13, x, y3);
+        x = vld1q_s8(p2 + k);
+        a20 = dot_s8(a20, x, y0); a21 = dot_s8(a21, x, y1); a22 = dot_s8(a22, x, y2); a23 = dot_s8(a23, x, y3);
+        x = vld1q_s8(p3 + k);
+        a30 = dot_s8(a30, x, y0); a31 = dot_s8(a31, x, y1); a32 = dot_s8(a32, x, y2); a33 = dot_s8(a33, x, y3);
+    }
+    float s0 = gb.scale(g), s1 = gb.scale(g + 1), s2 = gb.scale(g + 2), s3 = gb.scale(g + 3);
+    float sp = pb.scale(p);
+    out[0] = hsum_s32(a00) * sp * s0; out[1] = hsum_s32(a01) * sp * s1;
+    out[2] = hsum_s32(a02) * sp * s2; out[3] = hsum_s32(a03) * sp * s3;
+    out += ld;
+    sp = pb.scale(p + 1);
+    out[0] = hsum_s32(a10) * sp * s0; out[1] = hsum_s32(a11) * sp * s1;
+    out[2] = hsum_s32(a12) * sp * s2; out[3] = hsum_s32(a13) * sp * s3;
+    out += ld;
+    sp = pb.scale(p + 2);
+    out[0] = hsum_s32(a20) * sp * s0; out[1] = hsum_s32(a21) * sp * s1;
+    out[2] = hsum_s32(a22) * sp * s2; out[3] = hsum_s32(a23) * sp * s3;
+    out += ld;
+    sp = pb.scale(p + 3);
+    out[0] = hsum_s32(a30) * sp * s0; out[1] = hsum_s32(a31) * sp * s1;
+    out[2] = hsum_s32(a32) * sp * s2; out[3] = hsum_s32(a33) * sp * s3;
+#else
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++)
+            out[i * ld + j] = row_dot(pb, p + i, gb, g + j);
+#endif
+}
+
+/* pn probe rows against gallery rows g0.. g0 + gn, row length gn. */
+template <class Block>
+static void score_tile(const Block &pb, size_t pn, const Block &gb, size_t g0, size_t gn, float *scores)
+{
+    size_t p = 0;
+    for (; p + 4 <= pn; p += 4)
+    {
+        size_t g = 0;
+        for (; g + 4 <= gn; g += 4)
+            dot_4x4(pb, p, gb, g0 + g, scores + p * gn + g, gn);
+        for (; g < gn; g++)
+            for (size_t i = 0; i < 4; i++)
+                scores[(p + i) * gn + g] = row_dot(pb, p + i, gb, g0 + g);
+    }
+    for (; p < pn; p++)
+        for (size_t g = 0; g < gn; g++)
+            scores[p * gn + g] = row_dot(pb, p, gb, g0 + g);
+}
+
+/*-------------------------------------------
+                 All-vs-all search
+-------------------------------------------*/
+template <class Fn>
+static void run_threads(int threads, Fn fn)
+{
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; i++)
+        workers.push_back(std::thread(fn, i));
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+}
+
+/* score probe blocks taken from next_block against the gallery chunk starting at store row chunk_first. */
+template <class Block>
+static void search_chunk(const FeatureStore *store, const Block *gallery, size_t chunk_first, Block *probes,
+                         uint32_t k, std::atomic<size_t> *next_block, TopkEntry<float> *hits)
+{
+    size_t count = store->count();
+    std::vector<float> scores(SEARCH_PROBE_BLOCK * SEARCH_GALLERY_BLOCK);
+    size_t block;
+    while ((block = next_block->fetch_add(1)) * SEARCH_PROBE_BLOCK < count)
+    {
+        size_t p0 = block * SEARCH_PROBE_BLOCK;
+        size_t pn = std::min((size_t)SEARCH_PROBE_BLOCK, count - p0);
+        probes->resize(store->dim(), pn);
+        probes->convert(*store, p0, 0, pn);
+        for (size_t t0 = 0; t0 < gallery->count(); t0 += SEARCH_GALLERY_BLOCK)
+        {
+            size_t tn = std::min((size_t)SEARCH_GALLERY_BLOCK, gallery->count() - t0);
+            size_t g0 = chunk_first + t0;
+            score_tile(*probes, pn, *gallery, t0, tn, scores.data());
+            for (size_t p = 0; p < pn; p++)
+            {
+                float *row = scores.data() + p * tn;
+                if (p0 + p >= g0 && p0 + p < g0 + tn)
+                    row[p0 + p - g0] = -FLT_MAX;
+                /*
+                    the heap root is the probe's k-th best so far: most
+                    gallery rows are rejected by the vector compare in
+                    topk_next_above, gallery indexes only grow, so ties
+                    keep the earlier image as topk_select does.
+                */
+                TopkEntry<float> *heap = hits + (p0 + p) * k;
+                for (uint32_t i = topk_next_above(row, 0, tn, heap[0].value); i < tn;
+                     i = topk_next_above(row, i + 1, tn, heap[0].value))
+                {
+                    heap[0].value = row[i];
+                    heap[0].index = g0 + i;
+                    topk_sift_down(heap, k, 0);
+                }
+            }
+        }
+    }
+}
+
+template <class Block>
+static void search_blocks(const FeatureStore &store, int threads, uint32_t k, TopkEntry<float> *hits)
+{
+    size_t count = store.count();
+    Block gallery;
+    std::vector<Block> probes(threads);
+    for (size_t chunk_first = 0; chunk_first < count; chunk_first += SEARCH_GALLERY_CHUNK)
+    {
+        /* every thread converts a slice of the chunk, then all search against it */
+        size_t rows = std::min((size_t)SEARCH_GALLERY_CHUNK, count - chunk_first);
+        gallery.resize(store.dim(), rows);
+        run_threads(threads, [&](int t) {
+            gallery.convert(store, chunk_first, rows * t / threads, rows * (t + 1) / threads);
+        });
+        std::atomic<size_t> next_block(0);
+        run_threads(threads, [&](int t) {
+            search_chunk(&store, &gallery, chunk_first, &probes[t], k, &next_block, hits);
+        });
+    }
+}
+
+int search_store(const FeatureStore &store, bool int8, int threads, uint32_t k,
+                 std::vector<TopkEntry<float> > *hits, SearchStats *stats)
+{
+    size_t count = store.count();
+    if (!store.is_open() || k == 0 || k > SEARCH_MAX_TOPK || count < 2 || count > UINT32_MAX)
+    {
+        printf("search needs 2 or more features and 1 <= k <= %d\n", SEARCH_MAX_TOPK);
+        return -1;
+    }
+    if (threads <= 0)
+    {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = n > 0 ? (int)n : 1;
+    }
+    TopkEntry<float> empty;
+    empty.value = -FLT_MAX;
+    empty.index = UINT32_MAX;
+    hits->assign(count * k, empty);
+    int64_t t0 = get_time_us();
+    if (int8)
+        search_blocks<Int8Block>(store, threads, k, hits->data());
+    else
+        search_blocks<Fp32Block>(store, threads, k, hits->data());
+
+    /* pop the weakest into the back to get best-first order. */
+    for (size_t p = 0; p < count; p++)
+    {
+        TopkEntry<float> *heap = hits->data() + p * k;
+        for (uint32_t size = k; size > 1; size--)
+        {
+            TopkEntry<float> e = heap[0];
+            heap[0] = heap[size - 1];
+            topk_sift_down(heap, size - 1, 0);
+            heap[size - 1] = e;
+        }
+    }
+    stats->threads = threads;
+    stats->time_us = get_time_us() - t0;
+    stats->dots = (double)count * count;
+    return 0;
+}
+
+void identify_accuracy(const std::vector<TopkEntry<float> > &hits, uint32_t k,
+                       const std::vector<int> &labels, IdentifyReport *report)
+{
+    std::map<int, int> images;
+    for (size_t n = 0; n < labels.size(); n++)
+        if (labels[n] >= 0)
+            images[labels[n]]++;
+
+    report->probes = 0;
+    report->skipped = 0;
+    report->rank1 = 0;
+    report->rank5 = 0;
+    uint32_t rank5 = std::min(k, 5u);
+    for (size_t n = 0; n < labels.size(); n++)
+    {
+        if (labels[n] < 0 || images[labels[n]] < 2)
+        {
+            report->skipped++;
+            continue;
+        }
+        report->probes++;
+        const TopkEntry<float> *best = &hits[n * k];
+        for (uint32_t r = 0; r < rank5; r++)
+        {
+            if (best[r].index < labels.size() && labels[best[r].index] == labels[n])
+            {
+                if (r == 0)
+                    report->rank1++;
+                report->rank5++;
+                break;
+            }
+        }
+    }
+}
+
+void print_identify_report(const IdentifyReport &report, const SearchStats &stats, uint32_t dim)
+{
+    double seconds = stats.time_us / 1e6;
+    printf("===========identification result============\n");
+    printf("search: %.3g dot products of dim %u in %.2f s on %d threads, %.2f GMAC/s\n",
+           stats.dots, dim, seconds, stats.threads, seconds > 0 ? stats.dots * dim / seconds / 1e9 : 0.0);
+    printf("probes: %d, %d without a label or a second image skipped\n", report.probes, report.skipped);
+    if (report.probes > 0)
+    {
+        printf("rank-1: %.2f%%\n", 100.0 * report.rank1 / report.probes);
+        printf("rank-5: %.2f%%\n", 100.0 * report.rank5 / report.probes);
+    }
+    printf("============================================\n");
+}
@@ -0,0 +1,138 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __FACE_SEARCH_H__
+#define __FACE_SEARCH_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "feature_store.h"
+#include "topk.h"
+
+/*
+    Tile of the similarity matrix scored at once: a block of probes against
+    a block of gallery rows. With 512-d features one gallery tile is 128 KB
+    in fp32 and 32 KB in int8, it stays in L2 while the probes go through
+    it four rows at a time.
+*/
+#define SEARCH_PROBE_BLOCK   64
+#define SEARCH_GALLERY_BLOCK 64
+/*
+    gallery rows converted from the store per pass, shared by all threads:
+    8 MB in fp32 and 2 MB in int8 for 512-d features.
+*/
+#define SEARCH_GALLERY_CHUNK 4096
+#define SEARCH_MAX_TOPK      64
+
+/*
+    Rows of a feature store converted for the similarity kernels: L2
+    normalised fp32, padded with zeros to a multiple of 4 floats and 16
+    byte aligned.
+*/
+class Fp32Block
+{
+public:
+    Fp32Block();
+
+    /* room for count rows of dim, keeps the allocation when it shrinks. */
+    void resize(uint32_t dim, size_t count);
+    /*
+        convert store rows first + [begin, end) into block rows [begin, end),
+        several threads may convert distinct ranges at once.
+    */
+    void convert(const FeatureStore &store, size_t first, size_t begin, size_t end);
+
+    uint32_t dim() const { return dim_; }
+    uint32_t stride() const { return stride_; }
+    size_t count() const { return count_; }
+    const float *row(size_t index) const { return data_ + index * stride_; }
+
+private:
+    std::vector<float> buffer_;
+    float *data_;
+    uint32_t dim_;
+    uint32_t stride_;
+    size_t count_;
+};
+
+/*
+    Same rows quantised to int8: every row is L2 normalised, then scaled so
+    its largest value maps to 127. The dot product of two rows times both
+    row scales approximates their cosine similarity at a quarter of the
+    memory traffic of fp32. Rows are padded to a multiple of 16 bytes.
+*/
+class Int8Block
+{
+public:
+    Int8Block();
+
+    void resize(uint32_t dim, size_t count);
+    void convert(const FeatureStore &store, size_t first, size_t begin, size_t end);
+
+    uint32_t dim() const { return dim_; }
+    uint32_t stride() const { return stride_; }
+    size_t count() const { return count_; }
+    const int8_t *row(size_t index) const { return data_ + index * stride_; }
+    float scale(size_t index) const { return scales_[index]; }
+
+private:
+    std::vector<int8_t> buffer_;
+    int8_t *data_;
+    std::vector<float> scales_;
+    uint32_t dim_;
+    uint32_t stride_;
+    size_t count_;
+};
+
+/*
+    All-vs-all 1:N search over a mapped store: every row is a probe against
+    every other row. Nothing is copied up front: the gallery is streamed
+    out of the mapping SEARCH_GALLERY_CHUNK rows at a time, converted (and
+    for int8 quantised) once per chunk. Worker threads then convert their
+    probe block and score it tile by tile against the chunk, feeding each
+    tile row into the probe's top-k heap, so neither the count x count
+    similarity matrix nor a resident copy of the features exists. hits gets
+    k entries per probe, best first; the probe itself is left out.
+    threads <= 0 uses every online cpu.
+*/
+struct SearchStats
+{
+    int threads;
+    int64_t time_us;
+    double dots;        /* dot products computed */
+};
+
+int search_store(const FeatureStore &store, bool int8, int threads, uint32_t k,
+                 std::vector<TopkEntry<float> > *hits, SearchStats *stats);
+
+/*
+    identification accuracy of search_store hits. labels holds the identity
+    of every row, -1 if unknown. Probes without a label, or whose identity
+    has no other image, cannot be found and are not counted.
+*/
+struct IdentifyReport
+{
+    int probes;
+    int skipped;
+    int rank1;
+    int rank5;
+};
+
+void identify_accuracy(const std::vector<TopkEntry<float> > &hits, uint32_t k,
+                       const std::vector<int> &labels, IdentifyReport *report);
+void print_identify_report(const IdentifyReport &report, const SearchStats &stats, uint32_t dim);
+
+#endif /*__FACE_SEARCH_H__*/
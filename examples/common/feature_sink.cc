@@ -0,0 +1,154 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+
+#include "feature_sink.h"
+#include "stage_stats.h"
+#include "trace.h"
+
+FeatureSink::FeatureSink()
+    : record_size_(0), buffer_records_(0), current_(-1), current_count_(0), finishing_(false), failed_(false),
+      records_(0), batches_(0), full_waits_(0), wait_us_(0), write_us_(0), max_queued_(0)
+{
+}
+
+FeatureSink::~FeatureSink()
+{
+    finish();
+}
+
+int FeatureSink::start(size_t record_size, size_t buffer_records, int buffers, Consumer consume)
+{
+    if (record_size == 0 || buffer_records == 0 || buffers < 2)
+    {
+        printf("feature sink needs records, and at least two buffers\n");
+        return -1;
+    }
+    record_size_ = record_size;
+    buffer_records_ = buffer_records;
+    consume_ = consume;
+    buffers_.assign(buffers, std::vector<uint8_t>(record_size * buffer_records));
+    free_.clear();
+    for (int i = 0; i < buffers; i++)
+        free_.push_back(i);
+    finishing_ = false;
+    failed_ = false;
+    writer_ = std::thread(&FeatureSink::writer, this);
+    return 0;
+}
+
+uint8_t *FeatureSink::reserve()
+{
+    if (current_ < 0)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (free_.empty() && !failed_)
+        {
+            /* backpressure: the writer holds every buffer */
+            full_waits_++;
+            int64_t t0 = get_time_us();
+            space_.wait(lock, [this] { return !free_.empty() || failed_; });
+            wait_us_ += get_time_us() - t0;
+        }
+        if (failed_)
+            return NULL;
+        current_ = free_.front();
+        free_.pop_front();
+        current_count_ = 0;
+    }
+    return buffers_[current_].data() + current_count_ * record_size_;
+}
+
+void FeatureSink::commit()
+{
+    current_count_++;
+    records_++;
+    if (current_count_ == buffer_records_)
+        hand_over();
+}
+
+void FeatureSink::hand_over()
+{
+    if (current_ < 0)
+        return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    Batch batch = { current_, current_count_ };
+    queued_.push_back(batch);
+    if (queued_.size() > max_queued_)
+        max_queued_ = queued_.size();
+    current_ = -1;
+    current_count_ = 0;
+    ready_.notify_one();
+}
+
+void FeatureSink::writer()
+{
+    trace_thread_name("feature writer");
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        ready_.wait(lock, [this] { return !queued_.empty() || finishing_; });
+        if (queued_.empty())
+            break;
+        Batch batch = queued_.front();
+        queued_.pop_front();
+        bool skip = failed_;
+        lock.unlock();
+
+        int ret = 0;
+        if (!skip)
+        {
+            int64_t t0 = get_time_us();
+            ret = consume_(buffers_[batch.buffer].data(), batch.count);
+            int64_t t1 = get_time_us();
+            write_us_ += t1 - t0;
+            if (trace_enabled())
+                trace_event("write features", -1, t0, t1);
+        }
+
+        lock.lock();
+        batches_++;
+        if (ret < 0)
+            failed_ = true;
+        free_.push_back(batch.buffer);
+        space_.notify_one();
+    }
+}
+
+int FeatureSink::finish()
+{
+    if (!writer_.joinable())
+        return failed_ ? -1 : 0;
+    if (current_ >= 0 && current_count_ > 0)
+        hand_over();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        finishing_ = true;
+        ready_.notify_one();
+    }
+    writer_.join();
+    return failed_ ? -1 : 0;
+}
+
+void FeatureSink::print_report()
+{
+    if (buffers_.empty())
+        return;
+    printf("feature sink: %llu records in %llu writes of up to %d, %d buffers, max %d queued\n",
+           (unsigned long long)records_, (unsigned long long)batches_, (int)buffer_records_, (int)buffers_.size(),
+           (int)max_queued_);
+    printf("feature sink: write %.2f ms per batch, inference blocked %llu times for %.2f ms in total\n",
+           batches_ ? write_us_ / 1000.0 / batches_ : 0.0, (unsigned long long)full_waits_, wait_us_ / 1000.0);
+}
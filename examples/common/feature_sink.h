@@ -0,0 +1,94 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __FEATURE_SINK_H__
+#define __FEATURE_SINK_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+    Ring of preallocated buffers between the inference thread and a writer
+    thread, for fixed size records such as the embeddings of one image.
+
+    The producer copies a record into the slot returned by reserve() and
+    calls commit(); a full buffer is handed to the writer thread, which
+    passes the whole batch to the consumer (convert, write, fdatasync).
+    While the writer works on one buffer the producer fills the next, so
+    a slow flash write only stalls inference once every buffer is queued.
+    Those stalls are counted and reported as backpressure.
+*/
+class FeatureSink
+{
+public:
+    /* called on the writer thread with count records, returns < 0 on error. */
+    typedef std::function<int(const uint8_t *records, size_t count)> Consumer;
+
+    FeatureSink();
+    ~FeatureSink();
+
+    /* allocate buffers of buffer_records records each and start the writer. */
+    int start(size_t record_size, size_t buffer_records, int buffers, Consumer consume);
+    /* slot for the next record, waits while every buffer is queued. NULL once the consumer failed. */
+    uint8_t *reserve();
+    void commit();
+    /* hand over the partial buffer, wait for the writer and stop it. */
+    int finish();
+
+    void print_report();
+
+private:
+    FeatureSink(const FeatureSink &);
+    FeatureSink &operator=(const FeatureSink &);
+
+    struct Batch
+    {
+        int buffer;
+        size_t count;
+    };
+
+    void writer();
+    void hand_over();
+
+    size_t record_size_;
+    size_t buffer_records_;
+    std::vector<std::vector<uint8_t> > buffers_;
+    Consumer consume_;
+    int current_;               /* buffer being filled by the producer, -1 if none */
+    size_t current_count_;
+
+    std::mutex mutex_;
+    std::condition_variable ready_;     /* a batch is queued or finishing */
+    std::condition_variable space_;     /* the writer released a buffer */
+    std::deque<int> free_;
+    std::deque<Batch> queued_;
+    bool finishing_;
+    bool failed_;
+    std::thread writer_;
+
+    uint64_t records_;
+    uint64_t batches_;
+    uint64_t full_waits_;       /* reserve() found no free buffer */
+    int64_t wait_us_;
+    int64_t write_us_;
+    size_t max_queued_;
+};
+
+#endif /*__FEATURE_SINK_H__*/
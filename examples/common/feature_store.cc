@@ -0,0 +1,273 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "feature_store.h"
+#include "topk.h"
+
+/* rows are buffered up to this size and go out in one sequential write. */
+#define FEATURE_STORE_WRITE_BUFFER (1 << 20)
+
+size_t feature_type_size(FeatureType type)
+{
+    return type == FEATURE_FP16 ? 2 : 4;
+}
+
+int parse_feature_type(const char *name, FeatureType *type)
+{
+    if (strcmp(name, "fp32") == 0)
+        *type = FEATURE_FP32;
+    else if (strcmp(name, "fp16") == 0)
+        *type = FEATURE_FP16;
+    else
+        return -1;
+    return 0;
+}
+
+FeatureStore::FeatureStore()
+    : base_(NULL), map_size_(0), data_(NULL), dim_(0), count_(0), type_(FEATURE_FP32), normalized_(false),
+      row_size_(0)
+{
+}
+
+FeatureStore::~FeatureStore()
+{
+    close();
+}
+
+int FeatureStore::open(const std::string &path)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        printf("open %s fail! %s\n", path.c_str(), strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(feature_store_header))
+    {
+        printf("%s is not a feature store\n", path.c_str());
+        ::close(fd);
+        return -1;
+    }
+    map_size_ = st.st_size;
+    void *addr = mmap(NULL, map_size_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+    {
+        printf("mmap %s fail! %s\n", path.c_str(), strerror(errno));
+        map_size_ = 0;
+        return -1;
+    }
+    base_ = (const uint8_t *)addr;
+
+    const feature_store_header *header = (const feature_store_header *)base_;
+    if (header->magic != FEATURE_STORE_MAGIC || header->version != FEATURE_STORE_VERSION ||
+        (header->dtype != FEATURE_FP32 && header->dtype != FEATURE_FP16) || header->dim == 0 ||
+        header->data_offset + header->count * header->dim * feature_type_size((FeatureType)header->dtype) > map_size_)
+    {
+        printf("%s is not a feature store or is truncated\n", path.c_str());
+        close();
+        return -1;
+    }
+    dim_ = header->dim;
+    count_ = header->count;
+    type_ = (FeatureType)header->dtype;
+    normalized_ = header->normalized != 0;
+    row_size_ = dim_ * feature_type_size(type_);
+    data_ = base_ + header->data_offset;
+    return 0;
+}
+
+void FeatureStore::close()
+{
+    if (base_)
+    {
+        munmap((void *)base_, map_size_);
+        base_ = NULL;
+        map_size_ = 0;
+    }
+    data_ = NULL;
+    dim_ = 0;
+    count_ = 0;
+}
+
+void FeatureStore::row_float(size_t index, float *out) const
+{
+    if (type_ == FEATURE_FP32)
+    {
+        memcpy(out, row(index), row_size_);
+        return;
+    }
+    const uint16_t *h = (const uint16_t *)row(index);
+    for (uint32_t i = 0; i < dim_; i++)
+    {
+        out[i] = fp16_to_float(h[i]);
+    }
+}
+
+bool is_feature_store(const std::string &path)
+{
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (fp == NULL)
+        return false;
+    uint32_t magic = 0;
+    bool ok = fread(&magic, sizeof(magic), 1, fp) == 1 && magic == FEATURE_STORE_MAGIC;
+    fclose(fp);
+    return ok;
+}
+
+FeatureStoreWriter::FeatureStoreWriter()
+    : fd_(-1), count_(0), row_size_(0)
+{
+    memset(&header_, 0, sizeof(header_));
+}
+
+FeatureStoreWriter::~FeatureStoreWriter()
+{
+    if (fd_ >= 0)
+        close();
+}
+
+/* write the whole buffer, retrying short writes. */
+static int write_all(int fd, const uint8_t *p, size_t left)
+{
+    while (left > 0)
+    {
+        ssize_t n = write(fd, p, left);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        p += n;
+        left -= n;
+    }
+    return 0;
+}
+
+int FeatureStoreWriter::open(const std::string &path, uint32_t dim, FeatureType type, bool normalize)
+{
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0)
+    {
+        printf("open %s fail! %s\n", path.c_str(), strerror(errno));
+        return -1;
+    }
+    path_ = path;
+    count_ = 0;
+    memset(&header_, 0, sizeof(header_));
+    header_.magic = FEATURE_STORE_MAGIC;
+    header_.version = FEATURE_STORE_VERSION;
+    header_.dim = dim;
+    header_.dtype = type;
+    header_.normalized = normalize ? 1 : 0;
+    header_.data_offset = sizeof(feature_store_header);
+    row_size_ = dim * feature_type_size(type);
+    pending_.clear();
+    pending_.reserve(FEATURE_STORE_WRITE_BUFFER + row_size_);
+    scratch_.resize(dim);
+    /* count is 0 until close(), a torn file reads as empty rather than short. */
+    if (write_all(fd_, (const uint8_t *)&header_, sizeof(header_)) != 0)
+    {
+        printf("write %s fail! %s\n", path.c_str(), strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+int FeatureStoreWriter::append(const float *feature)
+{
+    uint32_t dim = header_.dim;
+    if (header_.normalized)
+    {
+        float sum = 0;
+        for (uint32_t i = 0; i < dim; i++)
+            sum += feature[i] * feature[i];
+        float inv = sum > 0 ? 1.0f / sqrtf(sum) : 0.0f;
+        for (uint32_t i = 0; i < dim; i++)
+            scratch_[i] = feature[i] * inv;
+        feature = scratch_.data();
+    }
+    size_t offset = pending_.size();
+    pending_.resize(offset + row_size_);
+    if (header_.dtype == FEATURE_FP16)
+    {
+        uint16_t *h = (uint16_t *)(pending_.data() + offset);
+        for (uint32_t i = 0; i < dim; i++)
+            h[i] = float_to_fp16(feature[i]);
+    }
+    else
+    {
+        memcpy(pending_.data() + offset, feature, row_size_);
+    }
+    count_++;
+    if (pending_.size() >= FEATURE_STORE_WRITE_BUFFER)
+        return flush();
+    return 0;
+}
+
+int FeatureStoreWriter::flush()
+{
+    if (pending_.empty())
+        return 0;
+    int ret = write_all(fd_, pending_.data(), pending_.size());
+    pending_.clear();
+    if (ret != 0)
+    {
+        printf("write %s fail! %s\n", path_.c_str(), strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+int FeatureStoreWriter::sync()
+{
+    if (flush() != 0)
+        return -1;
+    if (fdatasync(fd_) != 0)
+    {
+        printf("fdatasync %s fail! %s\n", path_.c_str(), strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+int FeatureStoreWriter::close()
+{
+    if (fd_ < 0)
+        return 0;
+    header_.count = count_;
+    int ret = flush();
+    if (ret == 0 && pwrite(fd_, &header_, sizeof(header_), 0) != (ssize_t)sizeof(header_))
+    {
+        printf("write %s fail! %s\n", path_.c_str(), strerror(errno));
+        ret = -1;
+    }
+    if (ret == 0 && fdatasync(fd_) != 0)
+        ret = -1;
+    ::close(fd_);
+    fd_ = -1;
+    return ret;
+}
@@ -0,0 +1,133 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __FEATURE_STORE_H__
+#define __FEATURE_STORE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/*
+    Binary feature store: one embedding per image, in image list order.
+
+        header (64 bytes) | count x dim matrix of fp32 or fp16
+
+    The matrix is contiguous and starts at data_offset, so a matcher can
+    mmap the file and use it in place: row i is at data_offset + i * dim *
+    element size. normalized is set when the rows were L2 normalised before
+    storing, cosine similarity is then a plain dot product.
+*/
+#define FEATURE_STORE_MAGIC   0x53464b52 /* "RKFS" */
+#define FEATURE_STORE_VERSION 1
+
+enum FeatureType
+{
+    FEATURE_FP32 = 0,
+    FEATURE_FP16 = 1,
+};
+
+typedef struct _feature_store_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t dim;
+    uint32_t dtype;         /* FeatureType */
+    uint64_t count;
+    uint32_t normalized;
+    uint32_t reserved0;
+    uint64_t data_offset;
+    uint64_t reserved[3];
+} feature_store_header;
+
+/* bytes per element of a FeatureType. */
+size_t feature_type_size(FeatureType type);
+
+/* "fp32" or "fp16" to a FeatureType, -1 if unknown. */
+int parse_feature_type(const char *name, FeatureType *type);
+
+/* read side: maps the file, rows are used in place. */
+class FeatureStore
+{
+public:
+    FeatureStore();
+    ~FeatureStore();
+
+    /* map path, 0 on success. */
+    int open(const std::string &path);
+    void close();
+
+    bool is_open() const { return base_ != NULL; }
+    uint32_t dim() const { return dim_; }
+    size_t count() const { return count_; }
+    FeatureType type() const { return type_; }
+    bool normalized() const { return normalized_; }
+    /* row index in the stored type. */
+    const void *row(size_t index) const { return data_ + index * row_size_; }
+    /* row index converted to dim floats. */
+    void row_float(size_t index, float *out) const;
+
+private:
+    FeatureStore(const FeatureStore &);
+    FeatureStore &operator=(const FeatureStore &);
+
+    const uint8_t *base_;
+    size_t map_size_;
+    const uint8_t *data_;
+    uint32_t dim_;
+    size_t count_;
+    FeatureType type_;
+    bool normalized_;
+    size_t row_size_;
+};
+
+/* true if path starts with the feature store magic. */
+bool is_feature_store(const std::string &path);
+
+/*
+    write side: rows are converted into a buffer that goes out in large
+    write() calls, the count is patched into the header by close().
+*/
+class FeatureStoreWriter
+{
+public:
+    FeatureStoreWriter();
+    ~FeatureStoreWriter();
+
+    int open(const std::string &path, uint32_t dim, FeatureType type, bool normalize);
+    /* append dim floats, converted to the store type. */
+    int append(const float *feature);
+    /* write out the buffered rows and fdatasync them. */
+    int sync();
+    int close();
+
+    uint64_t count() const { return count_; }
+
+private:
+    FeatureStoreWriter(const FeatureStoreWriter &);
+    FeatureStoreWriter &operator=(const FeatureStoreWriter &);
+
+    int flush();
+
+    int fd_;
+    std::string path_;
+    feature_store_header header_;
+    uint64_t count_;
+    size_t row_size_;
+    std::vector<uint8_t> pending_;      /* converted rows not written yet */
+    std::vector<float> scratch_;
+};
+
+#endif /*__FEATURE_STORE_H__*/
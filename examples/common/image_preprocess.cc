@@ -0,0 +1,211 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#include "opencv2/imgproc.hpp"
+
+#include "image_preprocess.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+/* bilinear weights in 8 bit fixed point, a blended pixel is within 1 of cv::resize. */
+#define RESIZE_WEIGHT_BITS 8
+#define RESIZE_WEIGHT_ONE (1 << RESIZE_WEIGHT_BITS)
+
+void tensor_input_size(const rknn_tensor_attr *attr, int *width, int *height)
+{
+    if (attr->fmt == RKNN_TENSOR_NCHW)
+    {
+        *width = attr->dims[0];
+        *height = attr->dims[1];
+    }
+    else
+    {
+        *width = attr->dims[1];
+        *height = attr->dims[2];
+    }
+}
+
+bool tensor_accepts_raw_rgb(const rknn_tensor_attr *attr)
+{
+    if (attr->type != RKNN_TENSOR_UINT8)
+        return false;
+    if (attr->qnt_type == RKNN_TENSOR_QNT_AFFINE_ASYMMETRIC)
+        return attr->zp == 0 && attr->scale == 1.0f;
+    if (attr->qnt_type == RKNN_TENSOR_QNT_DFP)
+        return attr->fl == 0;
+    return true;
+}
+
+/*
+    the two source taps and the weight of the second one for every destination
+    coordinate, with the pixel centre mapping of cv::INTER_LINEAR.
+*/
+static void resize_taps(int src_size, int dst_size, std::vector<int> &tap0, std::vector<int> &tap1,
+                        std::vector<uint16_t> &weight)
+{
+    tap0.resize(dst_size);
+    tap1.resize(dst_size);
+    weight.resize(dst_size);
+    float scale = (float)src_size / dst_size;
+    for (int d = 0; d < dst_size; d++)
+    {
+        float f = (d + 0.5f) * scale - 0.5f;
+        int s = (int)floorf(f);
+        f -= s;
+        if (s < 0) {
+            s = 0;
+            f = 0;
+        }
+        if (s >= src_size - 1) {
+            s = src_size - 1;
+            f = 0;
+        }
+        tap0[d] = s;
+        tap1[d] = s + 1 < src_size ? s + 1 : s;
+        weight[d] = (uint16_t)lrintf(f * RESIZE_WEIGHT_ONE);
+    }
+}
+
+/*
+    horizontal pass over one source row into 16 bit sums, already in RGB
+    order: interleaved for NHWC, one run of width values per channel for NCHW.
+*/
+static void resize_row(const uint8_t *src, const int *xofs0, const int *xofs1, const uint16_t *xw,
+                       int width, bool swap, bool planar, uint16_t *row)
+{
+    int c0 = swap ? 2 : 0;
+    int c2 = swap ? 0 : 2;
+    int step = planar ? 1 : 3;
+    uint16_t *r = row, *g = row + (planar ? width : 1), *b = row + (planar ? 2 * width : 2);
+    for (int x = 0; x < width; x++)
+    {
+        const uint8_t *p0 = src + xofs0[x];
+        const uint8_t *p1 = src + xofs1[x];
+        uint16_t a = xw[x];
+        uint16_t ia = RESIZE_WEIGHT_ONE - a;
+        r[x * step] = p0[c0] * ia + p1[c0] * a;
+        g[x * step] = p0[1] * ia + p1[1] * a;
+        b[x * step] = p0[c2] * ia + p1[c2] * a;
+    }
+}
+
+/* vertical pass: blend two row sums with weight b of row1 and round to uint8. */
+static void blend_rows(const uint16_t *row0, const uint16_t *row1, uint16_t b, uint8_t *dst, int n)
+{
+    uint32_t ib = RESIZE_WEIGHT_ONE - b;
+    int i = 0;
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    uint16x4_t w0 = vdup_n_u16((uint16_t)ib);
+    uint16x4_t w1 = vdup_n_u16(b);
+    for (; i + 8 <= n; i += 8)
+    {
+        uint16x8_t v0 = vld1q_u16(row0 + i);
+        uint16x8_t v1 = vld1q_u16(row1 + i);
+        uint32x4_t lo = vmlal_u16(vmull_u16(vget_low_u16(v0), w0), vget_low_u16(v1), w1);
+        uint32x4_t hi = vmlal_u16(vmull_u16(vget_high_u16(v0), w0), vget_high_u16(v1), w1);
+        uint16x8_t sum = vcombine_u16(vrshrn_n_u32(lo, 2 * RESIZE_WEIGHT_BITS),
+                                      vrshrn_n_u32(hi, 2 * RESIZE_WEIGHT_BITS));
+        vst1_u8(dst + i, vmovn_u16(sum));
+    }
+#endif
+    for (; i < n; i++)
+        dst[i] = (uint8_t)((row0[i] * ib + row1[i] * b + (1 << (2 * RESIZE_WEIGHT_BITS - 1))) >> (2 * RESIZE_WEIGHT_BITS));
+}
+
+/*
+    bilinear resize, B/R swap and layout in one pass over the output: every
+    source row is interpolated horizontally once into a 16 bit row buffer,
+    two such rows are kept and blended into dst, so no intermediate image
+    is written.
+*/
+static void resize_to_tensor(const cv::Mat &src, bool swap, int width, int height,
+                             rknn_tensor_format fmt, uint8_t *dst)
+{
+    std::vector<int> xofs0, xofs1, yofs0, yofs1;
+    std::vector<uint16_t> xw, yw;
+    resize_taps(src.cols, width, xofs0, xofs1, xw);
+    resize_taps(src.rows, height, yofs0, yofs1, yw);
+    for (int x = 0; x < width; x++)
+    {
+        xofs0[x] *= 3;
+        xofs1[x] *= 3;
+    }
+
+    bool planar = fmt == RKNN_TENSOR_NCHW;
+    int row_len = width * 3;
+    std::vector<uint16_t> buf(2 * row_len);
+    uint16_t *rows[2] = { buf.data(), buf.data() + row_len };
+    int held[2] = { -1, -1 };
+    size_t plane = (size_t)width * height;
+    for (int y = 0; y < height; y++)
+    {
+        int y0 = yofs0[y];
+        int y1 = yofs1[y];
+        /* downward the second row of one output row is the first of the next. */
+        if (held[0] != y0 && held[1] == y0) {
+            std::swap(rows[0], rows[1]);
+            std::swap(held[0], held[1]);
+        }
+        if (held[0] != y0) {
+            resize_row(src.ptr<uint8_t>(y0), xofs0.data(), xofs1.data(), xw.data(), width, swap, planar, rows[0]);
+            held[0] = y0;
+        }
+        if (held[1] != y1) {
+            resize_row(src.ptr<uint8_t>(y1), xofs0.data(), xofs1.data(), xw.data(), width, swap, planar, rows[1]);
+            held[1] = y1;
+        }
+        if (planar) {
+            for (int c = 0; c < 3; c++)
+                blend_rows(rows[0] + c * width, rows[1] + c * width, yw[y], dst + c * plane + (size_t)y * width, width);
+        } else {
+            blend_rows(rows[0], rows[1], yw[y], dst + (size_t)y * row_len, row_len);
+        }
+    }
+}
+
+void preprocess_to_tensor(const cv::Mat &src, bool src_is_rgb, int width, int height,
+                          rknn_tensor_format fmt, uint8_t *dst)
+{
+    if (src.cols != width || src.rows != height)
+    {
+        resize_to_tensor(src, !src_is_rgb, width, height, fmt, dst);
+        return;
+    }
+
+    if (fmt == RKNN_TENSOR_NHWC)
+    {
+        cv::Mat out(height, width, CV_8UC3, dst);
+        if (src_is_rgb)
+            src.copyTo(out);
+        else
+            cv::cvtColor(src, out, cv::COLOR_BGR2RGB);
+        return;
+    }
+
+    /* NCHW: split into the three planes, swapping B and R on the way. */
+    size_t plane = (size_t)width * height;
+    std::vector<cv::Mat> planes(3);
+    for (int c = 0; c < 3; c++)
+    {
+        int dst_c = src_is_rgb ? c : 2 - c;
+        planes[c] = cv::Mat(height, width, CV_8UC1, dst + dst_c * plane);
+    }
+    cv::split(src, planes);
+}
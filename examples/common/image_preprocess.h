@@ -0,0 +1,42 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __IMAGE_PREPROCESS_H__
+#define __IMAGE_PREPROCESS_H__
+
+#include <stdint.h>
+
+#include "opencv2/core/core.hpp"
+
+#include "rknn_api.h"
+
+/* width and height of an input tensor, dims are stored innermost first. */
+void tensor_input_size(const rknn_tensor_attr *attr, int *width, int *height);
+
+/* true if a uint8 RGB image can be written into the raw input tensor as is. */
+bool tensor_accepts_raw_rgb(const rknn_tensor_attr *attr);
+
+/*
+    Resize src to width x height and write it as RGB uint8 into dst, in the
+    NHWC or NCHW layout of fmt. src is BGR straight from the decoder, or
+    already RGB when src_is_rgb (e.g. a cached tensor). dst is typically
+    the mapped input tensor, so the image is written once with no staging
+    buffer in between. Resizing, channel swap and layout are fused into a
+    single pass (NEON where available), the bilinear result stays within 1
+    of cv::resize with INTER_LINEAR.
+*/
+void preprocess_to_tensor(const cv::Mat &src, bool src_is_rgb, int width, int height,
+                          rknn_tensor_format fmt, uint8_t *dst);
+
+#endif /*__IMAGE_PREPROCESS_H__*/
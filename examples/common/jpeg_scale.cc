@@ -0,0 +1,84 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "opencv2/imgcodecs.hpp"
+
+#include "jpeg_scale.h"
+
+bool jpeg_frame_size(const uint8_t *data, size_t size, int *width, int *height)
+{
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8)
+        return false;
+    size_t pos = 2;
+    while (pos + 4 <= size)
+    {
+        if (data[pos] != 0xFF)
+            return false;
+        uint8_t marker = data[pos + 1];
+        /* fill bytes before a marker */
+        if (marker == 0xFF)
+        {
+            pos++;
+            continue;
+        }
+        /* standalone markers carry no length */
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7))
+        {
+            pos += 2;
+            continue;
+        }
+        size_t length = ((size_t)data[pos + 2] << 8) | data[pos + 3];
+        /* SOF0..SOF15 except DHT (C4), JPG (C8) and DAC (CC) */
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+        {
+            if (pos + 9 > size)
+                return false;
+            *height = (data[pos + 5] << 8) | data[pos + 6];
+            *width = (data[pos + 7] << 8) | data[pos + 8];
+            return *width > 0 && *height > 0;
+        }
+        /* the scan starts before any frame header: not a valid stream */
+        if (marker == 0xDA || length < 2)
+            return false;
+        pos += 2 + length;
+    }
+    return false;
+}
+
+int jpeg_scale_factor(int width, int height, int target_width, int target_height, int max_factor)
+{
+    for (int factor = 8; factor > 1; factor /= 2)
+    {
+        /* libjpeg rounds scaled sizes up */
+        if (factor <= max_factor && (width + factor - 1) / factor >= target_width &&
+            (height + factor - 1) / factor >= target_height)
+            return factor;
+    }
+    return 1;
+}
+
+int jpeg_reduced_read_flags(int factor)
+{
+    switch (factor)
+    {
+    case 2:
+        return cv::IMREAD_REDUCED_COLOR_2;
+    case 4:
+        return cv::IMREAD_REDUCED_COLOR_4;
+    case 8:
+        return cv::IMREAD_REDUCED_COLOR_8;
+    default:
+        return cv::IMREAD_COLOR;
+    }
+}
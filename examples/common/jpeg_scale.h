@@ -0,0 +1,34 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __JPEG_SCALE_H__
+#define __JPEG_SCALE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* frame size from the SOF marker of a JPEG stream, false if not a JPEG. */
+bool jpeg_frame_size(const uint8_t *data, size_t size, int *width, int *height);
+
+/*
+    largest libjpeg DCT scale denominator (1, 2, 4 or 8, at most max_factor)
+    whose output of a width x height image still covers target_width x
+    target_height, so the final resize only ever shrinks.
+*/
+int jpeg_scale_factor(int width, int height, int target_width, int target_height, int max_factor);
+
+/* cv::imread flags decoding 1/factor of the size in colour. */
+int jpeg_reduced_read_flags(int factor);
+
+#endif /*__JPEG_SCALE_H__*/
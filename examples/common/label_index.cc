@@ -0,0 +1,153 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "label_index.h"
+
+/* 32-bit FNV-1a. */
+static uint32_t hash_bytes(const char *p, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+    {
+        h ^= (uint8_t)p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* decimal label in [p, end), the mapping may not be NUL terminated. */
+static int parse_label(const char *p, const char *end)
+{
+    bool negative = p < end && *p == '-';
+    if (negative)
+        p++;
+    int label = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++)
+        label = label * 10 + (*p - '0');
+    return negative ? -label : label;
+}
+
+LabelIndex::LabelIndex()
+    : base_(NULL), map_size_(0)
+{
+}
+
+LabelIndex::~LabelIndex()
+{
+    close();
+}
+
+int LabelIndex::open(const std::string &path)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        printf("open %s fail! %s\n", path.c_str(), strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        printf("label file %s is empty\n", path.c_str());
+        ::close(fd);
+        return -1;
+    }
+    map_size_ = st.st_size;
+    void *addr = mmap(NULL, map_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+    {
+        printf("mmap %s fail! %s\n", path.c_str(), strerror(errno));
+        map_size_ = 0;
+        return -1;
+    }
+    base_ = (const char *)addr;
+    madvise(addr, map_size_, MADV_SEQUENTIAL);
+
+    /* one pass: split lines into name and label, no copies of the names. */
+    const char *end = base_ + map_size_;
+    for (const char *line = base_; line < end;)
+    {
+        const char *eol = (const char *)memchr(line, '\n', end - line);
+        if (eol == NULL)
+            eol = end;
+        const char *name_end = line;
+        while (name_end < eol && *name_end != ' ' && *name_end != '\t')
+            name_end++;
+        const char *p = name_end;
+        while (p < eol && (*p == ' ' || *p == '\t'))
+            p++;
+        if (name_end > line && p < eol)
+        {
+            Entry e;
+            e.name_off = line - base_;
+            e.name_len = name_end - line;
+            e.hash = hash_bytes(line, e.name_len);
+            e.label = parse_label(p, eol);
+            entries_.push_back(e);
+        }
+        line = eol + 1;
+    }
+
+    size_t slot_count = 16;
+    while (slot_count < entries_.size() * 2)
+        slot_count <<= 1;
+    slots_.assign(slot_count, 0);
+    size_t mask = slot_count - 1;
+    for (size_t i = 0; i < entries_.size(); i++)
+    {
+        size_t s = entries_[i].hash & mask;
+        while (slots_[s] != 0)
+            s = (s + 1) & mask;
+        slots_[s] = i + 1;
+    }
+    printf("labels: %d entries from %s\n", (int)entries_.size(), path.c_str());
+    return 0;
+}
+
+void LabelIndex::close()
+{
+    if (base_)
+    {
+        munmap((void *)base_, map_size_);
+        base_ = NULL;
+        map_size_ = 0;
+    }
+    entries_.clear();
+    slots_.clear();
+}
+
+int LabelIndex::find(const std::string &name) const
+{
+    if (slots_.empty())
+        return -1;
+    uint32_t h = hash_bytes(name.data(), name.size());
+    size_t mask = slots_.size() - 1;
+    for (size_t s = h & mask; slots_[s] != 0; s = (s + 1) & mask)
+    {
+        const Entry &e = entries_[slots_[s] - 1];
+        if (e.hash == h && e.name_len == name.size() && memcmp(base_ + e.name_off, name.data(), e.name_len) == 0)
+            return e.label;
+    }
+    return -1;
+}
@@ -0,0 +1,63 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __LABEL_INDEX_H__
+#define __LABEL_INDEX_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/*
+    Ground truth labels of a validation set, "<image name> <label>" per line
+    (val.txt style), memory-mapped and indexed by image name.
+
+    The file is scanned once; names are not copied, each line costs one
+    entry (offset, length, hash, label) plus an open addressing slot, so
+    sets with millions of images load quickly in bounded memory.
+*/
+class LabelIndex
+{
+public:
+    LabelIndex();
+    ~LabelIndex();
+
+    /* map and index path, 0 on success. */
+    int open(const std::string &path);
+    void close();
+
+    size_t size() const { return entries_.size(); }
+    /* label of an image name, -1 if not listed. */
+    int find(const std::string &name) const;
+
+private:
+    struct Entry
+    {
+        size_t name_off;
+        uint32_t name_len;
+        uint32_t hash;
+        int label;
+    };
+
+    LabelIndex(const LabelIndex &);
+    LabelIndex &operator=(const LabelIndex &);
+
+    const char *base_;
+    size_t map_size_;
+    std::vector<Entry> entries_;
+    std::vector<uint32_t> slots_;   /* entry index + 1, 0 for empty; size is a power of two */
+};
+
+#endif /*__LABEL_INDEX_H__*/
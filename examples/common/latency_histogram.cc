@@ -0,0 +1,102 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+
+#include "latency_histogram.h"
+
+static int bucket_index(uint64_t v)
+{
+    if (v < LATENCY_SUB_COUNT)
+        return (int)v;
+    int msb = 63 - __builtin_clzll(v);
+    /* v >> shift lands in [LATENCY_HALF_COUNT, LATENCY_SUB_COUNT). */
+    int shift = msb - LATENCY_SUB_BITS + 1;
+    int index = LATENCY_SUB_COUNT + (shift - 1) * LATENCY_HALF_COUNT + (int)(v >> shift) - LATENCY_HALF_COUNT;
+    return index < LATENCY_BUCKETS ? index : LATENCY_BUCKETS - 1;
+}
+
+/* largest value that falls into bucket index. */
+static int64_t bucket_upper(int index)
+{
+    if (index < LATENCY_SUB_COUNT)
+        return index;
+    int shift = (index - LATENCY_SUB_COUNT) / LATENCY_HALF_COUNT + 1;
+    int64_t m = (index - LATENCY_SUB_COUNT) % LATENCY_HALF_COUNT + LATENCY_HALF_COUNT;
+    return ((m + 1) << shift) - 1;
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+void LatencyHistogram::reset()
+{
+    for (int i = 0; i < LATENCY_BUCKETS; i++)
+        buckets_[i] = 0;
+    count_ = 0;
+    sum_ = 0;
+    max_ = 0;
+}
+
+void LatencyHistogram::record(int64_t us)
+{
+    if (us < 0)
+        us = 0;
+    buckets_[bucket_index(us)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(us, std::memory_order_relaxed);
+    int64_t prev = max_.load(std::memory_order_relaxed);
+    while (us > prev && !max_.compare_exchange_weak(prev, us, std::memory_order_relaxed))
+    {
+    }
+}
+
+int64_t LatencyHistogram::percentile(double p) const
+{
+    uint64_t total = count_;
+    if (total == 0)
+        return 0;
+    /* rank of the sample that p percent of the samples do not exceed. */
+    uint64_t rank = (uint64_t)(p / 100.0 * total + 0.5);
+    if (rank < 1)
+        rank = 1;
+    if (rank > total)
+        rank = total;
+    uint64_t seen = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++)
+    {
+        seen += buckets_[i];
+        if (seen >= rank)
+        {
+            int64_t v = bucket_upper(i);
+            return v < max_ ? v : (int64_t)max_;
+        }
+    }
+    return max_;
+}
+
+void print_latency_header(const char *title)
+{
+    printf("=============== %s latency (us) ===============\n", title);
+    printf("%-18s %9s %9s %9s %9s %9s %9s %9s\n", "", "count", "mean", "p50", "p90", "p99", "p99.9", "max");
+}
+
+void LatencyHistogram::print_row(const char *name) const
+{
+    printf("%-18s %9llu %9.1f %9lld %9lld %9lld %9lld %9lld\n", name, (unsigned long long)count(), mean(),
+           (long long)percentile(50), (long long)percentile(90), (long long)percentile(99),
+           (long long)percentile(99.9), (long long)max());
+}
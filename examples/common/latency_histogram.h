@@ -0,0 +1,64 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __LATENCY_HISTOGRAM_H__
+#define __LATENCY_HISTOGRAM_H__
+
+#include <stdint.h>
+#include <atomic>
+
+#define LATENCY_SUB_BITS 7
+#define LATENCY_SUB_COUNT (1 << LATENCY_SUB_BITS)
+#define LATENCY_HALF_COUNT (LATENCY_SUB_COUNT / 2)
+#define LATENCY_BUCKETS (LATENCY_SUB_COUNT + 40 * LATENCY_HALF_COUNT)
+
+/*
+    HDR-style latency histogram in microseconds.
+
+    Values below 128 us are counted exactly, above that every power of two
+    is split into 64 linear buckets, so any percentile is reported within
+    1.6% over the whole range (up to ~2^46 us). Buckets are atomic counters,
+    several threads of a stage may record into the same histogram.
+*/
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void record(int64_t us);
+    void reset();
+
+    uint64_t count() const { return count_; }
+    int64_t sum() const { return sum_; }
+    int64_t max() const { return max_; }
+    double mean() const { return count_ ? (double)sum_ / count_ : 0; }
+    /* smallest recorded value bound with at least p percent of the samples at or below it. */
+    int64_t percentile(double p) const;
+
+    /* "p50 p90 p99 p99.9 max" row under print_latency_header(). */
+    void print_row(const char *name) const;
+
+private:
+    LatencyHistogram(const LatencyHistogram &);
+    LatencyHistogram &operator=(const LatencyHistogram &);
+
+    std::atomic<uint64_t> buckets_[LATENCY_BUCKETS];
+    std::atomic<uint64_t> count_;
+    std::atomic<int64_t> sum_;
+    std::atomic<int64_t> max_;
+};
+
+void print_latency_header(const char *title);
+
+#endif /*__LATENCY_HISTOGRAM_H__*/
@@ -0,0 +1,142 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <sstream>
+
+#include "layer_profile.h"
+
+static bool is_integer(const std::string &s)
+{
+    if (s.empty())
+        return false;
+    for (size_t i = 0; i < s.size(); i++)
+    {
+        if (s[i] < '0' || s[i] > '9')
+            return false;
+    }
+    return true;
+}
+
+int parse_perf_detail(const char *data, size_t len, std::vector<PerfLayer> &rows)
+{
+    rows.clear();
+    if (data == NULL)
+        return 0;
+    std::istringstream in(std::string(data, strnlen(data, len)));
+    std::string line;
+    std::vector<std::string> tokens;
+    while (std::getline(in, line))
+    {
+        std::istringstream ls(line);
+        std::string token;
+        tokens.clear();
+        while (ls >> token)
+            tokens.push_back(token);
+        if (tokens.size() < 3 || !is_integer(tokens.front()) || !is_integer(tokens.back()))
+            continue;
+        PerfLayer row;
+        row.id = atoi(tokens.front().c_str());
+        row.name = tokens[1];
+        /* the operator column is absent in some driver versions. */
+        for (size_t i = 2; i + 1 < tokens.size(); i++)
+        {
+            if (!row.op.empty())
+                row.op += ' ';
+            row.op += tokens[i];
+        }
+        row.time_us = atoll(tokens.back().c_str());
+        rows.push_back(row);
+    }
+    return rows.size();
+}
+
+LayerProfile::LayerProfile()
+    : inferences_(0), runs_(0), run_mean_(0)
+{
+}
+
+void LayerProfile::add(const std::vector<PerfLayer> &rows)
+{
+    if (rows.empty())
+        return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    inferences_++;
+    for (size_t i = 0; i < rows.size(); i++)
+    {
+        const PerfLayer &row = rows[i];
+        std::map<int, LayerStats>::iterator it = layers_.find(row.id);
+        if (it == layers_.end())
+        {
+            LayerStats s;
+            s.name = row.name;
+            s.op = row.op;
+            s.count = 0;
+            s.mean = 0;
+            s.m2 = 0;
+            it = layers_.insert(std::make_pair(row.id, s)).first;
+        }
+        LayerStats &s = it->second;
+        s.count++;
+        double delta = row.time_us - s.mean;
+        s.mean += delta / s.count;
+        s.m2 += delta * (row.time_us - s.mean);
+    }
+}
+
+void LayerProfile::add_run(int64_t run_us)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    runs_++;
+    run_mean_ += (run_us - run_mean_) / runs_;
+}
+
+void LayerProfile::print_report(int top_n)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (layers_.empty())
+    {
+        printf("layer profile: no perf detail collected\n");
+        return;
+    }
+    std::vector<std::pair<double, int> > ranked;
+    double total = 0;
+    for (std::map<int, LayerStats>::const_iterator it = layers_.begin(); it != layers_.end(); ++it)
+    {
+        ranked.push_back(std::make_pair(it->second.mean, it->first));
+        total += it->second.mean;
+    }
+    std::sort(ranked.begin(), ranked.end(), std::greater<std::pair<double, int> >());
+
+    printf("=============== hot layers over %llu inferences ===============\n", (unsigned long long)inferences_);
+    printf("sum of layer means: %.1f us", total);
+    if (runs_)
+        printf(", mean rknn run duration: %.1f us", run_mean_);
+    printf(", %d layers\n", (int)layers_.size());
+    printf("%4s %6s %-40s %-20s %10s %10s %7s %7s\n", "rank", "id", "name", "operator", "mean us", "stddev", "share", "cum");
+    double cumulative = 0;
+    for (int r = 0; r < (int)ranked.size() && r < top_n; r++)
+    {
+        const LayerStats &s = layers_[ranked[r].second];
+        double stddev = s.count > 1 ? sqrt(s.m2 / (s.count - 1)) : 0;
+        double share = total > 0 ? 100.0 * s.mean / total : 0;
+        cumulative += share;
+        printf("%4d %6d %-40s %-20s %10.1f %10.1f %6.1f%% %6.1f%%\n", r + 1, ranked[r].second, s.name.c_str(),
+               s.op.c_str(), s.mean, stddev, share, cumulative);
+    }
+}
@@ -0,0 +1,75 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __LAYER_PROFILE_H__
+#define __LAYER_PROFILE_H__
+
+#include <stdint.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/* one row of the RKNN_QUERY_PERF_DETAIL table. */
+struct PerfLayer
+{
+    int id;
+    std::string name;
+    std::string op;
+    int64_t time_us;
+};
+
+/*
+    parse the free-form perf_data string of RKNN_QUERY_PERF_DETAIL. Rows
+    look like "<layer id> <name> <operator ...> <time us>", every line that
+    does not start with a layer id and end with a time (titles, separators,
+    totals) is skipped. Returns the number of rows found.
+*/
+int parse_perf_detail(const char *data, size_t len, std::vector<PerfLayer> &rows);
+
+/*
+    Per-layer npu time over a whole dataset: mean and variance (Welford)
+    of every layer id, ranked by mean time in the report. Several contexts
+    may add to the same profile.
+*/
+class LayerProfile
+{
+public:
+    LayerProfile();
+
+    void add(const std::vector<PerfLayer> &rows);
+    /* RKNN_QUERY_PERF_RUN duration of the same inference. */
+    void add_run(int64_t run_us);
+
+    /* the top_n layers by mean time, with their share of the summed layer time. */
+    void print_report(int top_n);
+
+private:
+    struct LayerStats
+    {
+        std::string name;
+        std::string op;
+        uint64_t count;
+        double mean;
+        double m2;
+    };
+
+    std::mutex mutex_;
+    std::map<int, LayerStats> layers_;
+    uint64_t inferences_;
+    uint64_t runs_;
+    double run_mean_;
+};
+
+#endif /*__LAYER_PROFILE_H__*/
@@ -0,0 +1,73 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "model_file.h"
+
+ModelFile::ModelFile()
+    : data_(NULL), size_(0)
+{
+}
+
+ModelFile::~ModelFile()
+{
+    close();
+}
+
+int ModelFile::open(const std::string &path)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        printf("open %s fail! %s\n", path.c_str(), strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        printf("%s is empty\n", path.c_str());
+        ::close(fd);
+        return -1;
+    }
+    void *addr = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+    {
+        printf("mmap %s fail! %s\n", path.c_str(), strerror(errno));
+        return -1;
+    }
+    /* rknn_init reads the blob front to back once. */
+    madvise(addr, st.st_size, MADV_SEQUENTIAL);
+    data_ = (unsigned char *)addr;
+    size_ = st.st_size;
+    return 0;
+}
+
+void ModelFile::close()
+{
+    if (data_)
+    {
+        munmap(data_, size_);
+        data_ = NULL;
+        size_ = 0;
+    }
+}
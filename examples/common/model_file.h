@@ -0,0 +1,55 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __MODEL_FILE_H__
+#define __MODEL_FILE_H__
+
+#include <stddef.h>
+#include <string>
+
+/*
+    An .rknn model mapped from its file and handed to rknn_init as is,
+    without the malloc + fread copy. rknn_init builds its own copy of the
+    graph, so the mapping is only needed until the last context is created:
+    close() it right after init and the model no longer counts towards the
+    resident size for the rest of the run. Benchmarks that create contexts
+    later simply open the file again.
+
+    The mapping is private and writable, a runtime that patches the blob in
+    place gets copy-on-write pages while untouched pages stay shared with
+    the page cache.
+*/
+class ModelFile
+{
+public:
+    ModelFile();
+    ~ModelFile();
+
+    /* map path, 0 on success. */
+    int open(const std::string &path);
+    void close();
+
+    bool is_open() const { return data_ != NULL; }
+    unsigned char *data() const { return data_; }
+    int size() const { return (int)size_; }
+
+private:
+    ModelFile(const ModelFile &);
+    ModelFile &operator=(const ModelFile &);
+
+    unsigned char *data_;
+    size_t size_;
+};
+
+#endif /*__MODEL_FILE_H__*/
@@ -0,0 +1,435 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <string.h>
+#include <float.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "npu_runner.h"
+#include "stage_stats.h"
+#include "trace.h"
+
+void print_tensor_attr(const rknn_tensor_attr *attr)
+{
+    printf("index=%d name=%s n_dims=%d dims=[%d %d %d %d] n_elems=%d size=%d fmt=%d type=%d qnt_type=%d fl=%d zp=%d scale=%f\n",
+           attr->index, attr->name, attr->n_dims, attr->dims[3], attr->dims[2], attr->dims[1], attr->dims[0],
+           attr->n_elems, attr->size, 0, attr->type, attr->qnt_type, attr->fl, attr->zp, attr->scale);
+}
+
+NpuRunner::NpuRunner()
+    : ctx_(0), initialized_(false), init_us_(0), flags_(0), repeat_(1), last_frame_id_(0),
+      mapped_(false), profile_(NULL), profile_every_(1), completed_(0)
+{
+    memset(&io_num_, 0, sizeof(io_num_));
+    memset(&input_mem_, 0, sizeof(input_mem_));
+}
+
+NpuRunner::~NpuRunner()
+{
+    release();
+}
+
+int NpuRunner::init(unsigned char *model, int model_len, uint32_t flags, bool verbose)
+{
+    int64_t t0 = get_time_us();
+    int ret = rknn_init(&ctx_, model, model_len, flags);
+    init_us_ = get_time_us() - t0;
+    if (ret < 0)
+    {
+        printf("rknn_init fail! ret=%d\n", ret);
+        return -1;
+    }
+    initialized_ = true;
+    flags_ = flags;
+    if (verbose)
+        printf("rknn_init: %.2f ms\n", init_us_ / 1000.0);
+
+    ret = rknn_query(ctx_, RKNN_QUERY_IN_OUT_NUM, &io_num_, sizeof(io_num_));
+    if (ret != RKNN_SUCC)
+    {
+        printf("rknn_query fail! ret=%d\n", ret);
+        return -1;
+    }
+    if (verbose)
+    {
+        printf("model input num: %d, output num: %d\n", io_num_.n_input, io_num_.n_output);
+        printf("input tensors:\n");
+    }
+    input_attrs_.resize(io_num_.n_input);
+    memset(input_attrs_.data(), 0, input_attrs_.size() * sizeof(rknn_tensor_attr));
+    for (uint32_t i = 0; i < io_num_.n_input; i++)
+    {
+        input_attrs_[i].index = i;
+        ret = rknn_query(ctx_, RKNN_QUERY_INPUT_ATTR, &(input_attrs_[i]), sizeof(rknn_tensor_attr));
+        if (ret != RKNN_SUCC)
+        {
+            printf("rknn_query fail! ret=%d\n", ret);
+            return -1;
+        }
+        if (verbose)
+            print_tensor_attr(&(input_attrs_[i]));
+    }
+
+    if (verbose)
+        printf("output tensors:\n");
+    output_attrs_.resize(io_num_.n_output);
+    want_float_.assign(io_num_.n_output, true);
+    memset(output_attrs_.data(), 0, output_attrs_.size() * sizeof(rknn_tensor_attr));
+    for (uint32_t i = 0; i < io_num_.n_output; i++)
+    {
+        output_attrs_[i].index = i;
+        ret = rknn_query(ctx_, RKNN_QUERY_OUTPUT_ATTR, &(output_attrs_[i]), sizeof(rknn_tensor_attr));
+        if (ret != RKNN_SUCC)
+        {
+            printf("rknn_query fail! ret=%d\n", ret);
+            return -1;
+        }
+        if (verbose)
+            print_tensor_attr(&(output_attrs_[i]));
+    }
+    return 0;
+}
+
+void NpuRunner::release()
+{
+    if (mapped_)
+    {
+        rknn_inputs_unmap(ctx_, 1, &input_mem_);
+        mapped_ = false;
+    }
+    if (initialized_)
+    {
+        rknn_destroy(ctx_);
+        initialized_ = false;
+    }
+    in_flight_.clear();
+}
+
+int NpuRunner::pending() const
+{
+    int count = 0;
+    for (std::map<uint64_t, InFlight>::const_iterator it = in_flight_.begin(); it != in_flight_.end(); ++it)
+    {
+        if (it->second.tag >= 0)
+            count++;
+    }
+    return count;
+}
+
+int NpuRunner::map_input()
+{
+    if (is_async())
+    {
+        printf("zero-copy input needs sync mode\n");
+        return -1;
+    }
+    memset(&input_mem_, 0, sizeof(input_mem_));
+    int ret = rknn_inputs_map(ctx_, 1, &input_mem_);
+    if (ret < 0 || input_mem_.logical_addr == NULL)
+    {
+        printf("rknn_inputs_map fail! ret=%d\n", ret);
+        return -1;
+    }
+    mapped_ = true;
+    printf("input mapped: addr=%p size=%u\n", input_mem_.logical_addr, input_mem_.size);
+    return 0;
+}
+
+void NpuRunner::set_profile(LayerProfile *profile, int every_n)
+{
+    if (profile && is_async())
+    {
+        printf("layer profiling needs sync mode\n");
+        return;
+    }
+    if (profile && (flags_ & RKNN_FLAG_COLLECT_PERF_MASK) == 0)
+    {
+        printf("layer profiling needs RKNN_FLAG_COLLECT_PERF_MASK at rknn_init\n");
+        return;
+    }
+    profile_ = profile;
+    profile_every_ = every_n > 0 ? every_n : 1;
+}
+
+void NpuRunner::collect_profile()
+{
+    rknn_perf_detail detail;
+    memset(&detail, 0, sizeof(detail));
+    int ret = rknn_query(ctx_, RKNN_QUERY_PERF_DETAIL, &detail, sizeof(detail));
+    if (ret == RKNN_SUCC)
+    {
+        parse_perf_detail(detail.perf_data, detail.data_len, perf_rows_);
+        profile_->add(perf_rows_);
+    }
+    rknn_perf_run run;
+    memset(&run, 0, sizeof(run));
+    ret = rknn_query(ctx_, RKNN_QUERY_PERF_RUN, &run, sizeof(run));
+    if (ret == RKNN_SUCC)
+    {
+        profile_->add_run(run.run_duration);
+    }
+}
+
+int NpuRunner::submit(int tag, void *input, uint32_t size)
+{
+    int ret;
+    int64_t s0 = get_time_us();
+    if (input == NULL)
+    {
+        TraceScope trace("rknn_inputs_sync", tag);
+        /* flush cpu caches of the mapped tensor, no copy involved. */
+        ret = rknn_inputs_sync(ctx_, 1, &input_mem_);
+        if (ret < 0)
+        {
+            printf("rknn_inputs_sync fail! ret=%d\n", ret);
+            return -1;
+        }
+    }
+    else
+    {
+        rknn_input inputs[1];
+        memset(inputs, 0, sizeof(inputs));
+        inputs[0].index = 0;
+        inputs[0].type = RKNN_TENSOR_UINT8;
+        inputs[0].size = size;
+        inputs[0].fmt = RKNN_TENSOR_NHWC;
+        inputs[0].buf = input;
+
+        TraceScope trace("rknn_inputs_set", tag);
+        ret = rknn_inputs_set(ctx_, io_num_.n_input, inputs);
+        if (ret < 0)
+        {
+            printf("rknn_input_set fail! ret=%d\n", ret);
+            return -1;
+        }
+    }
+    input_latency_.record(get_time_us() - s0);
+
+    InFlight frame;
+    frame.tag = tag;
+    frame.avg_time = 0.f;
+    frame.min_time = FLT_MAX;
+    frame.max_time = -FLT_MAX;
+    /* repeating a run only makes sense when it blocks until the frame is done. */
+    int repeat = is_async() ? 1 : repeat_;
+    rknn_run_extend extend;
+    for (int e = 0; e < repeat; e++)
+    {
+        memset(&extend, 0, sizeof(extend));
+        int64_t t0 = get_time_us();
+        ret = rknn_run(ctx_, &extend);
+        int64_t t1 = get_time_us();
+        if (trace_enabled())
+            trace_event("rknn_run", tag, t0, t1);
+        if (ret < 0)
+        {
+            printf("rknn_run fail! ret=%d\n", ret);
+            return -1;
+        }
+        run_latency_.record(t1 - t0);
+        float mytime = (float)(t1 - t0) / 1000;
+        frame.avg_time += mytime;
+        frame.min_time = std::min(frame.min_time, mytime);
+        frame.max_time = std::max(frame.max_time, mytime);
+    }
+    frame.avg_time /= repeat;
+    last_frame_id_ = extend.frame_id;
+    in_flight_[extend.frame_id] = frame;
+    return 0;
+}
+
+int NpuRunner::get_outputs(NpuFrame *frame)
+{
+    rknn_output outputs[io_num_.n_output];
+    memset(outputs, 0, sizeof(outputs));
+    for (uint32_t i = 0; i < io_num_.n_output; i++)
+    {
+        outputs[i].want_float = want_float_[i] && output_attrs_[i].type != RKNN_TENSOR_FLOAT32 ? 1 : 0;
+    }
+    rknn_output_extend extend;
+    memset(&extend, 0, sizeof(extend));
+    int64_t t0 = get_time_us();
+    int ret = rknn_outputs_get(ctx_, io_num_.n_output, outputs, &extend);
+    int64_t t1 = get_time_us();
+    output_latency_.record(t1 - t0);
+    if (ret < 0)
+    {
+        printf("rknn_outputs_get fail! ret=%d\n", ret);
+        return -1;
+    }
+
+    /* in sync mode the outputs always belong to the run just issued. */
+    uint64_t frame_id = is_async() ? extend.frame_id : last_frame_id_;
+    std::map<uint64_t, InFlight>::iterator it = in_flight_.find(frame_id);
+    int status = 0;
+    if (it != in_flight_.end())
+    {
+        if (it->second.tag >= 0)
+        {
+            frame->tag = it->second.tag;
+            frame->avg_time = it->second.avg_time;
+            frame->min_time = it->second.min_time;
+            frame->max_time = it->second.max_time;
+            frame->outputs.resize(io_num_.n_output);
+            for (uint32_t i = 0; i < io_num_.n_output; i++)
+            {
+                uint8_t *buffer = (uint8_t *)outputs[i].buf;
+                frame->outputs[i].assign(buffer, buffer + outputs[i].size);
+            }
+            status = 1;
+            /* the perf queries are only valid once rknn_outputs_get returned the frame. */
+            if (profile_ && completed_ % profile_every_ == 0)
+            {
+                collect_profile();
+            }
+            completed_++;
+        }
+        /* the frame is only known once the outputs name their frame_id. */
+        if (trace_enabled())
+            trace_event("rknn_outputs_get", it->second.tag, t0, t1);
+        in_flight_.erase(it);
+    }
+    rknn_outputs_release(ctx_, io_num_.n_output, outputs);
+    return status;
+}
+
+int NpuRunner::run(int tag, void *input, uint32_t size, NpuFrame *frame)
+{
+    if (submit(tag, input, size) < 0)
+    {
+        return -1;
+    }
+    return get_outputs(frame);
+}
+
+int NpuRunner::run_mapped(int tag, NpuFrame *frame)
+{
+    if (!mapped_ || submit(tag, NULL, 0) < 0)
+    {
+        return -1;
+    }
+    return get_outputs(frame);
+}
+
+void NpuRunner::print_report()
+{
+    if (input_latency_.count() == 0)
+    {
+        return;
+    }
+    print_latency_header("npu");
+    input_latency_.print_row(mapped_ ? "rknn_inputs_sync" : "rknn_inputs_set");
+    run_latency_.print_row("rknn_run");
+    output_latency_.print_row("rknn_outputs_get");
+}
+
+int NpuRunner::flush(NpuFrame *frame)
+{
+    if (input_attrs_.empty())
+    {
+        return 0;
+    }
+    blank_.resize(input_attrs_[0].n_elems);
+    /* bounded, a frame_id the driver never reports must not loop forever. */
+    for (int i = 0; i < 4 && pending() > 0; i++)
+    {
+        if (submit(-1, blank_.data(), blank_.size()) < 0)
+        {
+            return -1;
+        }
+        int ret = get_outputs(frame);
+        if (ret != 0)
+        {
+            return ret;
+        }
+    }
+    return 0;
+}
+
+int npu_priority_flag(const char *name, uint32_t *flag)
+{
+    if (strcmp(name, "high") == 0)
+        *flag = RKNN_FLAG_PRIOR_HIGH;
+    else if (strcmp(name, "medium") == 0)
+        *flag = RKNN_FLAG_PRIOR_MEDIUM;
+    else if (strcmp(name, "low") == 0)
+        *flag = RKNN_FLAG_PRIOR_LOW;
+    else
+        return -1;
+    return 0;
+}
+
+static bool benchmark_runner(NpuRunner *runner, int frames)
+{
+    std::vector<uint8_t> input(runner->input_attrs()[0].n_elems);
+    NpuFrame frame;
+    for (int i = 0; i < frames; i++)
+    {
+        if (runner->run(i, input.data(), input.size(), &frame) < 0)
+        {
+            return false;
+        }
+    }
+    while (runner->pending() > 0)
+    {
+        if (runner->flush(&frame) <= 0)
+        {
+            break;
+        }
+    }
+    return true;
+}
+
+float npu_benchmark_fps(unsigned char *model, int model_len, uint32_t flags, int frames, int contexts)
+{
+    if (frames <= 0 || contexts <= 0)
+    {
+        return 0;
+    }
+    /* create every context before timing, rknn_init is not part of the rate. */
+    std::vector<std::unique_ptr<NpuRunner> > runners;
+    for (int i = 0; i < contexts; i++)
+    {
+        runners.push_back(std::unique_ptr<NpuRunner>(new NpuRunner()));
+        if (runners.back()->init(model, model_len, flags, false) < 0)
+        {
+            return 0;
+        }
+    }
+    std::atomic<bool> ok(true);
+    std::vector<std::thread> threads;
+    int64_t t0 = get_time_us();
+    for (int i = 0; i < contexts; i++)
+    {
+        NpuRunner *runner = runners[i].get();
+        threads.push_back(std::thread([runner, frames, &ok]() {
+            if (!benchmark_runner(runner, frames))
+                ok = false;
+        }));
+    }
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+        threads[i].join();
+    }
+    int64_t t1 = get_time_us();
+    if (!ok)
+    {
+        return 0;
+    }
+    return t1 > t0 ? (float)contexts * frames * 1000000.0f / (t1 - t0) : 0;
+}
@@ -0,0 +1,160 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __NPU_RUNNER_H__
+#define __NPU_RUNNER_H__
+
+#include <stdint.h>
+#include <map>
+#include <vector>
+
+#include "rknn_api.h"
+#include "latency_histogram.h"
+#include "layer_profile.h"
+
+/* outputs of one inference, tagged with the caller's frame tag. */
+struct NpuFrame
+{
+    int tag;
+    std::vector<std::vector<uint8_t> > outputs;
+    float avg_time;     /* rknn_run time in ms, over the repeat count */
+    float min_time;
+    float max_time;
+};
+
+void print_tensor_attr(const rknn_tensor_attr *attr);
+
+/*
+    One rknn context and the inputs_set / run / outputs_get sequence.
+
+    With RKNN_FLAG_ASYNC_MASK, rknn_outputs_get returns the outputs of the
+    previous run while the npu works on the current one. Every run records
+    its frame_id, and outputs are matched back to the caller's tag through
+    the frame_id reported by rknn_outputs_get, so a result is never
+    attributed to the wrong image.
+*/
+class NpuRunner
+{
+public:
+    NpuRunner();
+    ~NpuRunner();
+
+    /*
+        rknn_init with flags and query the model's inputs and outputs. The
+        model buffer is not used after init returns.
+    */
+    int init(unsigned char *model, int model_len, uint32_t flags, bool verbose = true);
+    void release();
+
+    /*
+        fetch outputs dequantized to float, or raw in their own type. Set for
+        all outputs or per output; float32 outputs are always fetched as they
+        are, there is nothing to convert.
+    */
+    void set_want_float(bool want_float) { want_float_.assign(want_float_.size(), want_float); }
+    void set_want_float(uint32_t output, bool want_float) { want_float_[output] = want_float; }
+    /* run every input repeat times to time rknn_run, sync mode only. */
+    void set_repeat(int repeat) { repeat_ = repeat > 0 ? repeat : 1; }
+
+    rknn_context context() const { return ctx_; }
+    /* time spent in rknn_init alone, without reading the model. */
+    int64_t init_us() const { return init_us_; }
+    bool is_async() const { return (flags_ & RKNN_FLAG_ASYNC_MASK) != 0; }
+    const rknn_input_output_num &io_num() const { return io_num_; }
+    const std::vector<rknn_tensor_attr> &input_attrs() const { return input_attrs_; }
+    const std::vector<rknn_tensor_attr> &output_attrs() const { return output_attrs_; }
+
+    /*
+        run one uint8 NHWC input tagged tag. returns < 0 on error, 1 if
+        frame holds a completed result (in async mode usually the previous
+        input's) and 0 if nothing completed yet.
+    */
+    int run(int tag, void *input, uint32_t size, NpuFrame *frame);
+
+    /*
+        zero-copy input: map input 0 with rknn_inputs_map so the caller can
+        preprocess straight into it, then call run_mapped(). Sync mode only,
+        the buffer must not change while the npu reads it.
+    */
+    int map_input();
+    uint8_t *mapped_input() const { return mapped_ ? (uint8_t *)input_mem_.logical_addr : NULL; }
+    int run_mapped(int tag, NpuFrame *frame);
+
+    /*
+        with RKNN_FLAG_COLLECT_PERF_MASK set at init, query the per-layer perf
+        detail after the outputs of every n-th frame were fetched and add it
+        to profile. Sync mode only, the query describes the run that just
+        finished.
+    */
+    void set_profile(LayerProfile *profile, int every_n);
+
+    /* latency of passing the input, running and fetching outputs over all frames. */
+    void print_report();
+
+    /* number of submitted inputs whose outputs were not returned yet. */
+    int pending() const;
+    /* async mode: run a blank input to drain one pending frame, same returns as run(). */
+    int flush(NpuFrame *frame);
+
+private:
+    struct InFlight
+    {
+        int tag;            /* -1 for the blank frames pushed by flush() */
+        float avg_time;
+        float min_time;
+        float max_time;
+    };
+
+    /* input NULL submits the mapped input. */
+    int submit(int tag, void *input, uint32_t size);
+    void collect_profile();
+    int get_outputs(NpuFrame *frame);
+
+    NpuRunner(const NpuRunner &);
+    NpuRunner &operator=(const NpuRunner &);
+
+    rknn_context ctx_;
+    bool initialized_;
+    int64_t init_us_;
+    uint32_t flags_;
+    std::vector<bool> want_float_;     /* per output */
+    int repeat_;
+    rknn_input_output_num io_num_;
+    std::vector<rknn_tensor_attr> input_attrs_;
+    std::vector<rknn_tensor_attr> output_attrs_;
+    std::map<uint64_t, InFlight> in_flight_;    /* keyed by rknn frame_id */
+    uint64_t last_frame_id_;
+    std::vector<uint8_t> blank_;
+    bool mapped_;
+    rknn_tensor_mem input_mem_;
+    LayerProfile *profile_;
+    int profile_every_;
+    uint64_t completed_;        /* frames returned to the caller, blank frames excluded */
+    std::vector<PerfLayer> perf_rows_;
+    LatencyHistogram input_latency_;    /* rknn_inputs_set, or rknn_inputs_sync when mapped */
+    LatencyHistogram run_latency_;
+    LatencyHistogram output_latency_;
+};
+
+/* RKNN_FLAG_PRIOR_* for "high", "medium" or "low", -1 if unknown. */
+int npu_priority_flag(const char *name, uint32_t *flag);
+
+/*
+    frames per second of set/run/get on a blank input, used to compare modes.
+    With contexts > 1, every context runs frames inputs on its own thread and
+    the combined rate is returned.
+*/
+float npu_benchmark_fps(unsigned char *model, int model_len, uint32_t flags, int frames, int contexts = 1);
+
+#endif /*__NPU_RUNNER_H__*/
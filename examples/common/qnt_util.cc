@@ -0,0 +1,77 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <math.h>
+
+#include "qnt_util.h"
+#include "topk.h"
+
+uint32_t tensor_type_size(rknn_tensor_type type)
+{
+    switch (type)
+    {
+    case RKNN_TENSOR_FLOAT32:
+        return 4;
+    case RKNN_TENSOR_FLOAT16:
+    case RKNN_TENSOR_INT16:
+        return 2;
+    case RKNN_TENSOR_INT8:
+    case RKNN_TENSOR_UINT8:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+float qnt_dequantize(const void *buf, uint32_t index, const rknn_tensor_attr *attr)
+{
+    float q;
+    switch (attr->type)
+    {
+    case RKNN_TENSOR_FLOAT32:
+        return ((const float *)buf)[index];
+    case RKNN_TENSOR_FLOAT16:
+        return fp16_to_float(((const uint16_t *)buf)[index]);
+    case RKNN_TENSOR_INT8:
+        q = ((const int8_t *)buf)[index];
+        break;
+    case RKNN_TENSOR_UINT8:
+        q = ((const uint8_t *)buf)[index];
+        break;
+    case RKNN_TENSOR_INT16:
+        q = ((const int16_t *)buf)[index];
+        break;
+    default:
+        return 0;
+    }
+
+    switch (attr->qnt_type)
+    {
+    case RKNN_TENSOR_QNT_AFFINE_ASYMMETRIC:
+        return (q - (float)attr->zp) * attr->scale;
+    case RKNN_TENSOR_QNT_DFP:
+        return ldexpf(q, -attr->fl);
+    default:
+        return q;
+    }
+}
+
+bool qnt_preserves_order(const rknn_tensor_attr *attr)
+{
+    if (attr->qnt_type == RKNN_TENSOR_QNT_AFFINE_ASYMMETRIC)
+    {
+        return attr->scale > 0;
+    }
+    return true;
+}
@@ -0,0 +1,34 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __QNT_UTIL_H__
+#define __QNT_UTIL_H__
+
+#include <stdint.h>
+
+#include "rknn_api.h"
+
+/* bytes per element of a tensor type, 0 if unknown. */
+uint32_t tensor_type_size(rknn_tensor_type type);
+
+/* convert element index of a raw (want_float = 0) output buffer to float. */
+float qnt_dequantize(const void *buf, uint32_t index, const rknn_tensor_attr *attr);
+
+/*
+    true if dequantisation keeps the order of the raw values, so top-k can
+    run on the integers: DFP always does, affine needs a positive scale.
+*/
+bool qnt_preserves_order(const rknn_tensor_attr *attr);
+
+#endif /*__QNT_UTIL_H__*/
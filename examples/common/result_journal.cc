@@ -0,0 +1,163 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include <fstream>
+
+#include "result_journal.h"
+#include "trace.h"
+
+ResultJournal::ResultJournal()
+    : fd_(-1), closing_(false), failed_(false)
+{
+}
+
+ResultJournal::~ResultJournal()
+{
+    close();
+}
+
+int ResultJournal::open(const std::string &path, bool resume)
+{
+    close();
+    path_ = path;
+    loaded_.clear();
+    off_t valid_size = 0;
+    if (resume)
+    {
+        std::ifstream in(path.c_str(), std::ios::binary);
+        std::string line;
+        /* only newline terminated lines were completely written. */
+        while (in.is_open() && std::getline(in, line) && !in.eof())
+        {
+            ImageResult result;
+            if (parse_result(line, &result))
+                loaded_.push_back(result);
+            valid_size += line.size() + 1;
+        }
+    }
+
+    int flags = O_WRONLY | O_CREAT | (resume ? 0 : O_TRUNC);
+    fd_ = ::open(path.c_str(), flags, 0644);
+    if (fd_ < 0)
+    {
+        printf("open %s fail! %s\n", path.c_str(), strerror(errno));
+        return -1;
+    }
+    if (resume && (ftruncate(fd_, valid_size) != 0 || lseek(fd_, valid_size, SEEK_SET) < 0))
+    {
+        printf("truncate %s fail! %s\n", path.c_str(), strerror(errno));
+        ::close(fd_);
+        fd_ = -1;
+        return -1;
+    }
+    closing_ = false;
+    failed_ = false;
+    writer_ = std::thread(&ResultJournal::writer, this);
+    return 0;
+}
+
+int ResultJournal::append(const ImageResult &result)
+{
+    if (fd_ < 0 || failed_)
+        return -1;
+    std::unique_lock<std::mutex> lock(mutex_);
+    space_.wait(lock, [this]() { return queued_.size() < 4 * JOURNAL_SYNC_RECORDS; });
+    queued_.push_back(result);
+    if (queued_.size() >= JOURNAL_SYNC_RECORDS)
+        ready_.notify_one();
+    return 0;
+}
+
+void ResultJournal::writer()
+{
+    trace_thread_name("result writer");
+    std::vector<ImageResult> batch;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        ready_.wait_for(lock, std::chrono::milliseconds(JOURNAL_SYNC_MS),
+                        [this]() { return closing_ || queued_.size() >= JOURNAL_SYNC_RECORDS; });
+        bool closing = closing_;
+        batch.swap(queued_);
+        space_.notify_all();
+        lock.unlock();
+        /* later batches are still written, the run is failed at close */
+        if (write_batch(batch) != 0)
+            failed_ = true;
+        batch.clear();
+        lock.lock();
+        if (closing && queued_.empty())
+            break;
+    }
+}
+
+int ResultJournal::write_batch(const std::vector<ImageResult> &batch)
+{
+    if (batch.empty())
+        return 0;
+    TraceScope trace("write results");
+    line_buf_.clear();
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        line_buf_ += format_result(batch[i]);
+        line_buf_ += '\n';
+    }
+    const char *p = line_buf_.data();
+    size_t left = line_buf_.size();
+    while (left > 0)
+    {
+        ssize_t n = write(fd_, p, left);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            printf("write %s fail! %s\n", path_.c_str(), strerror(errno));
+            return -1;
+        }
+        p += n;
+        left -= n;
+    }
+    if (fdatasync(fd_) != 0)
+    {
+        printf("fdatasync %s fail! %s\n", path_.c_str(), strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+int ResultJournal::close()
+{
+    if (fd_ < 0)
+        return 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closing_ = true;
+    }
+    ready_.notify_one();
+    writer_.join();
+    int ret = failed_ ? -1 : 0;
+    if (::close(fd_) != 0)
+    {
+        printf("close %s fail! %s\n", path_.c_str(), strerror(errno));
+        ret = -1;
+    }
+    fd_ = -1;
+    return ret;
+}
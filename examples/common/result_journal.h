@@ -0,0 +1,82 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __RESULT_JOURNAL_H__
+#define __RESULT_JOURNAL_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "result_record.h"
+
+#define JOURNAL_SYNC_RECORDS 64
+#define JOURNAL_SYNC_MS 1000
+
+/*
+    Append-only result file that survives a crash or a reboot of the board.
+
+    append() only queues the record; a writer thread formats the JSON lines
+    and writes them with one write() + fdatasync() every JOURNAL_SYNC_RECORDS
+    results or JOURNAL_SYNC_MS, whichever comes first, so the caller does no
+    formatted I/O and at most one batch is lost. When opened for resume, the
+    complete records already in the file are loaded and a torn last line is
+    cut off before appending continues.
+*/
+class ResultJournal
+{
+public:
+    ResultJournal();
+    ~ResultJournal();
+
+    /* create (or with resume, reopen and load) path, 0 on success. */
+    int open(const std::string &path, bool resume);
+    /* write out what is queued, -1 if any record did not reach storage. */
+    int close();
+
+    bool is_open() const { return fd_ >= 0; }
+    /* false once a batch failed to reach storage, the file then has a gap. */
+    bool ok() const { return !failed_; }
+    /* results found in the file when it was opened for resume. */
+    const std::vector<ImageResult> &loaded() const { return loaded_; }
+
+    /* queue a record, blocks only while the writer is several batches behind. */
+    int append(const ImageResult &result);
+
+private:
+    ResultJournal(const ResultJournal &);
+    ResultJournal &operator=(const ResultJournal &);
+
+    void writer();
+    /* format, write out and flush batch to storage. */
+    int write_batch(const std::vector<ImageResult> &batch);
+
+    int fd_;
+    std::string path_;
+    std::string line_buf_;
+    std::vector<ImageResult> loaded_;
+
+    std::mutex mutex_;
+    std::condition_variable ready_;     /* a batch is full or closing */
+    std::condition_variable space_;     /* the writer took a batch */
+    std::vector<ImageResult> queued_;
+    bool closing_;
+    std::atomic<bool> failed_;      /* sticky, set by the writer thread */
+    std::thread writer_;
+};
+
+#endif /*__RESULT_JOURNAL_H__*/
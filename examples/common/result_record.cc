@@ -0,0 +1,134 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "result_record.h"
+
+static void append_escaped(std::string &out, const std::string &s)
+{
+    for (size_t i = 0; i < s.size(); i++)
+    {
+        if (s[i] == '"' || s[i] == '\\')
+            out += '\\';
+        out += s[i];
+    }
+}
+
+std::string format_result(const ImageResult &result)
+{
+    char buf[64];
+    std::string line = "{\"image\":\"";
+    append_escaped(line, result.name);
+    snprintf(buf, sizeof(buf), "\",\"label\":%d,\"top\":[", result.label);
+    line += buf;
+    for (int i = 0; i < result.top_num; i++)
+    {
+        snprintf(buf, sizeof(buf), i ? ",%u" : "%u", result.top[i]);
+        line += buf;
+    }
+    line += "],\"score\":[";
+    for (int i = 0; i < result.top_num; i++)
+    {
+        snprintf(buf, sizeof(buf), i ? ",%.6g" : "%.6g", result.score[i]);
+        line += buf;
+    }
+    snprintf(buf, sizeof(buf), "],\"npu_ms\":%.3f}", result.npu_ms);
+    line += buf;
+    return line;
+}
+
+/* position just after "key":, npos if the key is missing. */
+static size_t find_key(const std::string &line, const char *key)
+{
+    std::string k = std::string("\"") + key + "\":";
+    size_t pos = line.find(k);
+    return pos == std::string::npos ? pos : pos + k.size();
+}
+
+/* parse a [a,b,...] list of numbers at pos, returns the element count or -1. */
+static int parse_list(const std::string &line, size_t pos, double *values, int max_values)
+{
+    if (pos == std::string::npos || pos >= line.size() || line[pos] != '[')
+        return -1;
+    const char *p = line.c_str() + pos + 1;
+    int n = 0;
+    while (*p != ']')
+    {
+        char *end;
+        double v = strtod(p, &end);
+        if (end == p || n >= max_values)
+            return -1;
+        values[n++] = v;
+        p = end;
+        if (*p == ',')
+            p++;
+        else if (*p != ']')
+            return -1;
+    }
+    return n;
+}
+
+bool parse_result(const std::string &line, ImageResult *result)
+{
+    size_t pos = find_key(line, "image");
+    if (pos == std::string::npos || pos >= line.size() || line[pos] != '"')
+        return false;
+    result->name.clear();
+    for (pos++; pos < line.size() && line[pos] != '"'; pos++)
+    {
+        if (line[pos] == '\\' && pos + 1 < line.size())
+            pos++;
+        result->name += line[pos];
+    }
+    if (pos >= line.size())
+        return false;
+
+    pos = find_key(line, "label");
+    if (pos == std::string::npos)
+        return false;
+    result->label = atoi(line.c_str() + pos);
+
+    double top[RESULT_TOP_NUM];
+    double score[RESULT_TOP_NUM];
+    int top_num = parse_list(line, find_key(line, "top"), top, RESULT_TOP_NUM);
+    int score_num = parse_list(line, find_key(line, "score"), score, RESULT_TOP_NUM);
+    if (top_num < 0 || score_num != top_num)
+        return false;
+    result->top_num = top_num;
+    for (int i = 0; i < top_num; i++)
+    {
+        result->top[i] = (uint32_t)top[i];
+        result->score[i] = (float)score[i];
+    }
+
+    pos = find_key(line, "npu_ms");
+    result->npu_ms = pos == std::string::npos ? 0.f : (float)atof(line.c_str() + pos);
+    return true;
+}
+
+int parse_shard(const char *arg, int *shard_index, int *shard_count)
+{
+    int index, count;
+    if (sscanf(arg, "%d/%d", &index, &count) != 2 || count <= 0 || index < 0 || index >= count)
+    {
+        printf("invalid shard %s, expected i/n with 0 <= i < n\n", arg);
+        return -1;
+    }
+    *shard_index = index;
+    *shard_count = count;
+    return 0;
+}
@@ -0,0 +1,62 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __RESULT_RECORD_H__
+#define __RESULT_RECORD_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define RESULT_TOP_NUM 5
+
+/*
+    Per-image classification result, stored one JSON object per line:
+
+    {"image":"ILSVRC2012_val_00000001.JPEG","label":65,"top":[65,62,...],"score":[0.9,...],"npu_ms":4.1}
+
+    Shards of a run each write their own file, rknn_merge_results reads
+    them back to compute the global Top1/Top5.
+*/
+struct ImageResult
+{
+    std::string name;
+    int label;                          /* ground truth, -1 if unknown */
+    int top_num;
+    uint32_t top[RESULT_TOP_NUM];       /* class ids, best first */
+    float score[RESULT_TOP_NUM];
+    float npu_ms;
+};
+
+/* one JSON line, without the trailing newline. */
+std::string format_result(const ImageResult &result);
+/* parse a line written by format_result, false if malformed. */
+bool parse_result(const std::string &line, ImageResult *result);
+
+/* "i/n" with 0 <= i < n, 0 on success. */
+int parse_shard(const char *arg, int *shard_index, int *shard_count);
+/* keep every shard_count-th entry starting at shard_index, the list must be sorted. */
+template <typename T>
+void select_shard(std::vector<T> &list, int shard_index, int shard_count)
+{
+    /* striding keeps shards balanced whatever the ordering of the names. */
+    size_t n = 0;
+    for (size_t i = shard_index; i < list.size(); i += shard_count)
+    {
+        list[n++] = list[i];
+    }
+    list.resize(n);
+}
+
+#endif /*__RESULT_RECORD_H__*/
@@ -0,0 +1,62 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <time.h>
+
+#include "stage_stats.h"
+
+int64_t get_time_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+StageStats::StageStats(const char *name, int threads)
+    : name_(name), threads_(threads), items_(0), busy_us_(0)
+{
+}
+
+void print_stage_report(const std::vector<StageStats *> &stages, int64_t wall_us)
+{
+    double wall_s = wall_us / 1000000.0;
+    printf("=============== pipeline stages ===============\n");
+    printf("%-12s %7s %9s %10s %10s %7s\n", "stage", "threads", "items", "items/s", "us/item", "busy");
+    for (size_t i = 0; i < stages.size(); i++)
+    {
+        StageStats *s = stages[i];
+        uint64_t items = s->items();
+        double rate = wall_s > 0 ? items / wall_s : 0;
+        double per_item = items > 0 ? (double)s->busy_us() / items : 0;
+        /* busy ratio of the stage's workers over the whole run. */
+        double busy = wall_us > 0 ? 100.0 * s->busy_us() / ((double)wall_us * s->threads()) : 0;
+        printf("%-12s %7d %9llu %10.2f %10.1f %6.1f%%\n", s->name().c_str(), s->threads(),
+               (unsigned long long)items, rate, per_item, busy);
+    }
+    printf("wall time: %.3f s\n", wall_s);
+    print_latency_header("stage");
+    for (size_t i = 0; i < stages.size(); i++)
+    {
+        stages[i]->latency().print_row(stages[i]->name().c_str());
+    }
+}
+
+void print_queue_report(const char *name, const queue_stats &stats)
+{
+    double avg = stats.samples > 0 ? (double)stats.depth_sum / stats.samples : 0;
+    printf("queue %-10s capacity=%zu avg=%.2f max=%zu full_waits=%llu empty_waits=%llu\n",
+           name, stats.capacity, avg, stats.max_depth,
+           (unsigned long long)stats.full_waits, (unsigned long long)stats.empty_waits);
+}
@@ -0,0 +1,67 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __STAGE_STATS_H__
+#define __STAGE_STATS_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "bounded_queue.h"
+#include "latency_histogram.h"
+
+/* monotonic clock in microseconds. */
+int64_t get_time_us();
+
+/*
+    Throughput counters and latency histogram of one pipeline stage, over
+    the whole run. A stage may be run by several threads (e.g. the decoder
+    pool), so all counters are atomic.
+*/
+class StageStats
+{
+public:
+    StageStats(const char *name, int threads);
+
+    /* account one processed item which kept a worker busy for busy_us. */
+    void add(int64_t busy_us)
+    {
+        items_ += 1;
+        busy_us_ += busy_us;
+        latency_.record(busy_us);
+    }
+
+    const std::string &name() const { return name_; }
+    int threads() const { return threads_; }
+    uint64_t items() const { return items_; }
+    int64_t busy_us() const { return busy_us_; }
+    const LatencyHistogram &latency() const { return latency_; }
+
+private:
+    std::string name_;
+    int threads_;
+    std::atomic<uint64_t> items_;
+    std::atomic<int64_t> busy_us_;
+    LatencyHistogram latency_;
+};
+
+/* print per-stage throughput, utilisation and latency percentiles over a run of wall_us. */
+void print_stage_report(const std::vector<StageStats *> &stages, int64_t wall_us);
+
+/* print average/max occupancy and blocking counts of a named queue. */
+void print_queue_report(const char *name, const queue_stats &stats);
+
+#endif /*__STAGE_STATS_H__*/
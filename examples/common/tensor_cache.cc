@@ -0,0 +1,224 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tensor_cache.h"
+
+#define TENSOR_CACHE_MAGIC   0x43544b52 /* "RKTC" */
+/* bumped whenever preprocessing changes the tensors, 2: fused bilinear resize */
+#define TENSOR_CACHE_VERSION 2
+#define TENSOR_CACHE_ALIGN   4096
+
+typedef struct _tensor_cache_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels;
+    uint32_t count;
+    uint64_t tensor_size;
+    uint64_t data_offset;
+} tensor_cache_header;
+
+typedef struct _tensor_cache_entry
+{
+    uint64_t name_hash;
+    uint32_t valid;
+    uint32_t reserved;
+} tensor_cache_entry;
+
+uint64_t hash_name(const std::string &name)
+{
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < name.size(); i++)
+    {
+        h ^= (uint8_t)name[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+std::string tensor_cache_path(const std::string &dir, int width, int height, int channels, int decode_factor)
+{
+    char name[64];
+    if (decode_factor > 1)
+        snprintf(name, sizeof(name), "tensors_%dx%dx%d_d%d.cache", width, height, channels, decode_factor);
+    else
+        snprintf(name, sizeof(name), "tensors_%dx%dx%d.cache", width, height, channels);
+    if (dir.empty() || dir[dir.size() - 1] == '/')
+    {
+        return dir + name;
+    }
+    return dir + "/" + name;
+}
+
+TensorCache::TensorCache()
+    : fd_(-1), base_(NULL), map_size_(0), data_offset_(0), tensor_size_(0), width_(0), height_(0),
+      hits_(0), misses_(0)
+{
+}
+
+TensorCache::~TensorCache()
+{
+    close();
+}
+
+int TensorCache::open(const std::string &path, int width, int height, int channels,
+                      const std::vector<std::string> &names)
+{
+    close();
+    path_ = path;
+    tensor_size_ = (size_t)width * height * channels;
+    width_ = width;
+    height_ = height;
+    size_t table_size = sizeof(tensor_cache_header) + names.size() * sizeof(tensor_cache_entry);
+    data_offset_ = (table_size + TENSOR_CACHE_ALIGN - 1) / TENSOR_CACHE_ALIGN * TENSOR_CACHE_ALIGN;
+    map_size_ = data_offset_ + names.size() * tensor_size_;
+
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd_ < 0)
+    {
+        printf("open tensor cache %s fail! %s\n", path.c_str(), strerror(errno));
+        return -1;
+    }
+
+    /* an existing cache is reused only if it was built for the same geometry and list size. */
+    bool reset = true;
+    struct stat st;
+    tensor_cache_header header;
+    if (fstat(fd_, &st) == 0 && (size_t)st.st_size == map_size_ &&
+        pread(fd_, &header, sizeof(header), 0) == (ssize_t)sizeof(header))
+    {
+        reset = header.magic != TENSOR_CACHE_MAGIC || header.version != TENSOR_CACHE_VERSION ||
+                header.width != (uint32_t)width || header.height != (uint32_t)height ||
+                header.channels != (uint32_t)channels || header.count != names.size();
+    }
+    if (reset)
+    {
+        if (ftruncate(fd_, 0) != 0 || ftruncate(fd_, map_size_) != 0)
+        {
+            printf("resize tensor cache %s fail! %s\n", path.c_str(), strerror(errno));
+            close();
+            return -1;
+        }
+    }
+
+    void *addr = mmap(NULL, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (addr == MAP_FAILED)
+    {
+        printf("mmap tensor cache %s fail! %s\n", path.c_str(), strerror(errno));
+        base_ = NULL;
+        close();
+        return -1;
+    }
+    base_ = (uint8_t *)addr;
+    madvise(base_ + data_offset_, map_size_ - data_offset_, MADV_SEQUENTIAL);
+
+    if (reset)
+    {
+        memset(&header, 0, sizeof(header));
+        header.magic = TENSOR_CACHE_MAGIC;
+        header.version = TENSOR_CACHE_VERSION;
+        header.width = width;
+        header.height = height;
+        header.channels = channels;
+        header.count = names.size();
+        header.tensor_size = tensor_size_;
+        header.data_offset = data_offset_;
+        memcpy(base_, &header, sizeof(header));
+    }
+
+    hashes_.resize(names.size());
+    for (size_t i = 0; i < names.size(); i++)
+    {
+        hashes_[i] = hash_name(names[i]);
+    }
+    printf("tensor cache %s: %s, %zu entries of %zu bytes\n", path.c_str(),
+           reset ? "created" : "reused", names.size(), tensor_size_);
+    return 0;
+}
+
+void TensorCache::close()
+{
+    if (base_)
+    {
+        msync(base_, map_size_, MS_SYNC);
+        munmap(base_, map_size_);
+        base_ = NULL;
+    }
+    if (fd_ >= 0)
+    {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+const uint8_t *TensorCache::get(int index)
+{
+    if (!base_ || index < 0 || (size_t)index >= hashes_.size())
+    {
+        return NULL;
+    }
+    tensor_cache_entry *entry = (tensor_cache_entry *)(base_ + sizeof(tensor_cache_header)) + index;
+    if (entry->valid && entry->name_hash == hashes_[index])
+    {
+        hits_++;
+        return slot(index);
+    }
+    misses_++;
+    return NULL;
+}
+
+bool TensorCache::contains(int index) const
+{
+    if (!base_ || index < 0 || (size_t)index >= hashes_.size())
+    {
+        return false;
+    }
+    const tensor_cache_entry *entry = (const tensor_cache_entry *)(base_ + sizeof(tensor_cache_header)) + index;
+    return entry->valid && entry->name_hash == hashes_[index];
+}
+
+void TensorCache::put(int index, const uint8_t *tensor)
+{
+    if (!base_ || index < 0 || (size_t)index >= hashes_.size())
+    {
+        return;
+    }
+    tensor_cache_entry *entry = (tensor_cache_entry *)(base_ + sizeof(tensor_cache_header)) + index;
+    entry->valid = 0;
+    memcpy(slot(index), tensor, tensor_size_);
+    entry->name_hash = hashes_[index];
+    /* publish the entry only after its tensor is complete. */
+    __sync_synchronize();
+    entry->valid = 1;
+}
+
+void TensorCache::print_report()
+{
+    if (!base_)
+    {
+        return;
+    }
+    printf("tensor cache %s: hits=%llu misses=%llu\n", path_.c_str(),
+           (unsigned long long)hits_, (unsigned long long)misses_);
+}
@@ -0,0 +1,86 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __TENSOR_CACHE_H__
+#define __TENSOR_CACHE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+/*
+    Memory-mapped cache of preprocessed input tensors (resized RGB uint8).
+
+    One file holds every image of a list for one input geometry:
+
+        header | entry table (name hash, valid flag) | page aligned tensors
+
+    Slots are filled the first time an image goes through the decoder and
+    read back by later runs, so the tensor can be handed to rknn_inputs_set
+    straight from the mapping. An entry is only used when the hash of the
+    image name matches, a stale or partial cache is simply refilled.
+*/
+class TensorCache
+{
+public:
+    TensorCache();
+    ~TensorCache();
+
+    /* map (and create or reset when needed) the cache for names, 0 on success. */
+    int open(const std::string &path, int width, int height, int channels,
+             const std::vector<std::string> &names);
+    void close();
+
+    bool is_open() const { return base_ != NULL; }
+    size_t tensor_size() const { return tensor_size_; }
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+    /* tensor of image index, NULL when not cached yet. */
+    const uint8_t *get(int index);
+    /* true if index is cached, without counting a hit or miss. */
+    bool contains(int index) const;
+    /* store the tensor of image index, thread safe for distinct indexes. */
+    void put(int index, const uint8_t *tensor);
+
+    void print_report();
+
+private:
+    uint8_t *slot(int index) const { return base_ + data_offset_ + (size_t)index * tensor_size_; }
+
+    TensorCache(const TensorCache &);
+    TensorCache &operator=(const TensorCache &);
+
+    int fd_;
+    uint8_t *base_;
+    size_t map_size_;
+    size_t data_offset_;
+    size_t tensor_size_;
+    int width_;
+    int height_;
+    std::string path_;
+    std::vector<uint64_t> hashes_;
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+};
+
+/* cache file of one input geometry inside dir, e.g. dir/tensors_224x224x3.cache, a reduced decode factor gets its own file. */
+std::string tensor_cache_path(const std::string &dir, int width, int height, int channels, int decode_factor = 1);
+
+/* 64-bit FNV-1a hash of an image name. */
+uint64_t hash_name(const std::string &name);
+
+#endif /*__TENSOR_CACHE_H__*/
@@ -0,0 +1,118 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string.h>
+#include <math.h>
+
+#include "topk.h"
+
+float fp16_to_float(uint16_t h)
+{
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1f;
+    uint32_t mant = h & 0x3ff;
+    uint32_t bits;
+    if (exp == 0)
+    {
+        /* zero or subnormal */
+        float f = ldexpf((float)mant, -24);
+        return sign ? -f : f;
+    }
+    if (exp == 0x1f)
+    {
+        bits = sign | 0x7f800000 | (mant << 13);
+    }
+    else
+    {
+        bits = sign | ((exp + 112) << 23) | (mant << 13);
+    }
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+uint16_t float_to_fp16(float f)
+{
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    uint16_t sign = (bits >> 16) & 0x8000;
+    int32_t exp = (int32_t)((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mant = bits & 0x7fffff;
+    if (((bits >> 23) & 0xff) == 0xff)
+    {
+        /* inf or nan, keep nan quiet */
+        return sign | 0x7c00 | (mant ? 0x200 : 0);
+    }
+    if (exp >= 0x1f)
+    {
+        return sign | 0x7c00;
+    }
+    if (exp <= 0)
+    {
+        /* subnormal or zero: shift the implicit one into the mantissa */
+        if (exp < -10)
+            return sign;
+        mant |= 0x800000;
+        uint32_t shift = 14 - exp;
+        uint32_t half = mant >> shift;
+        uint32_t rest = mant & ((1u << shift) - 1);
+        uint32_t mid = 1u << (shift - 1);
+        if (rest > mid || (rest == mid && (half & 1)))
+            half++;
+        return sign | half;
+    }
+    uint32_t half = ((uint32_t)exp << 10) | (mant >> 13);
+    uint32_t rest = mant & 0x1fff;
+    /* a carry out of the mantissa correctly bumps the exponent */
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+        half++;
+    return sign | (uint16_t)half;
+}
+
+uint32_t topk_select_fp16(const uint16_t *data, uint32_t n, uint32_t k, uint32_t *indexes, float *values)
+{
+    std::vector<uint16_t> keys(n);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        keys[i] = fp16_order_key(data[i]);
+    }
+    uint32_t count = topk_select(keys.data(), n, k, indexes);
+    if (values)
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            values[i] = fp16_to_float(data[indexes[i]]);
+        }
+    }
+    return count;
+}
+
+uint32_t topk_select_tensor(const void *buf, rknn_tensor_type type, uint32_t n, uint32_t k, uint32_t *indexes)
+{
+    switch (type)
+    {
+    case RKNN_TENSOR_FLOAT32:
+        return topk_select((const float *)buf, n, k, indexes);
+    case RKNN_TENSOR_FLOAT16:
+        return topk_select_fp16((const uint16_t *)buf, n, k, indexes);
+    case RKNN_TENSOR_INT8:
+        return topk_select((const int8_t *)buf, n, k, indexes);
+    case RKNN_TENSOR_UINT8:
+        return topk_select((const uint8_t *)buf, n, k, indexes);
+    case RKNN_TENSOR_INT16:
+        return topk_select((const int16_t *)buf, n, k, indexes);
+    default:
+        return 0;
+    }
+}
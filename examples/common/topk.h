@@ -0,0 +1,159 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __TOPK_H__
+#define __TOPK_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "rknn_api.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+/*
+    Top-K selection with a bounded min-heap, O(n log k) for any k <= n.
+
+    The heap root is the weakest of the current k winners, so most elements
+    are rejected by a single compare against it. Ties are stable: of two
+    equal scores the lower index ranks first. Results are written best
+    first and the number of results, min(k, n), is returned.
+*/
+template <typename T>
+struct TopkEntry
+{
+    T value;
+    uint32_t index;
+};
+
+/* true if a ranks below b. */
+template <typename T>
+inline bool topk_worse(const TopkEntry<T> &a, const TopkEntry<T> &b)
+{
+    return a.value < b.value || (a.value == b.value && a.index > b.index);
+}
+
+template <typename T>
+inline void topk_sift_down(TopkEntry<T> *heap, uint32_t size, uint32_t pos)
+{
+    while (true)
+    {
+        uint32_t l = 2 * pos + 1;
+        uint32_t r = l + 1;
+        uint32_t m = pos;
+        if (l < size && topk_worse(heap[l], heap[m]))
+            m = l;
+        if (r < size && topk_worse(heap[r], heap[m]))
+            m = r;
+        if (m == pos)
+            break;
+        TopkEntry<T> t = heap[pos];
+        heap[pos] = heap[m];
+        heap[m] = t;
+        pos = m;
+    }
+}
+
+/* index of the first element of data[begin, n) greater than threshold, n if none. */
+template <typename T>
+inline uint32_t topk_next_above(const T *data, uint32_t begin, uint32_t n, T threshold)
+{
+    uint32_t i = begin;
+    while (i < n && !(data[i] > threshold))
+        i++;
+    return i;
+}
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+/* float specialisation skipping four scores per compare. */
+template <>
+inline uint32_t topk_next_above<float>(const float *data, uint32_t begin, uint32_t n, float threshold)
+{
+    uint32_t i = begin;
+    float32x4_t th = vdupq_n_f32(threshold);
+    for (; i + 4 <= n; i += 4)
+    {
+        uint32x4_t gt = vcgtq_f32(vld1q_f32(data + i), th);
+        uint32x2_t any = vorr_u32(vget_low_u32(gt), vget_high_u32(gt));
+        if (vget_lane_u32(vpmax_u32(any, any), 0))
+            break;
+    }
+    while (i < n && !(data[i] > threshold))
+        i++;
+    return i;
+}
+#endif
+
+template <typename T>
+uint32_t topk_select(const T *data, uint32_t n, uint32_t k, uint32_t *indexes, T *values = NULL)
+{
+    if (k > n)
+        k = n;
+    if (k == 0)
+        return 0;
+
+    std::vector<TopkEntry<T> > heap(k);
+    for (uint32_t i = 0; i < k; i++)
+    {
+        heap[i].value = data[i];
+        heap[i].index = i;
+    }
+    for (int32_t i = (int32_t)k / 2 - 1; i >= 0; i--)
+        topk_sift_down(heap.data(), k, i);
+
+    /* a later index never wins a tie, so only strictly greater scores enter. */
+    for (uint32_t i = topk_next_above(data, k, n, heap[0].value); i < n;
+         i = topk_next_above(data, i + 1, n, heap[0].value))
+    {
+        heap[0].value = data[i];
+        heap[0].index = i;
+        topk_sift_down(heap.data(), k, 0);
+    }
+
+    /* pop the weakest into the back to get best-first order. */
+    for (uint32_t size = k; size > 0; size--)
+    {
+        TopkEntry<T> e = heap[0];
+        heap[0] = heap[size - 1];
+        topk_sift_down(heap.data(), size - 1, 0);
+        indexes[size - 1] = e.index;
+        if (values)
+            values[size - 1] = e.value;
+    }
+    return k;
+}
+
+/* fp16 helpers, the order key maps half floats onto ordered uint16 values. */
+float fp16_to_float(uint16_t h);
+/* round to nearest even, out of range values become infinity. */
+uint16_t float_to_fp16(float f);
+static inline uint16_t fp16_order_key(uint16_t h)
+{
+    return (h & 0x8000) ? (uint16_t)~h : (uint16_t)(h | 0x8000);
+}
+
+/* top-k of raw fp16 scores, values are returned as float. */
+uint32_t topk_select_fp16(const uint16_t *data, uint32_t n, uint32_t k, uint32_t *indexes, float *values = NULL);
+
+/*
+    top-k of an output buffer of the given tensor type (float32, float16,
+    int8, uint8 or int16). Only the indexes are returned, the scores are
+    read back by the caller in whatever domain it needs.
+*/
+uint32_t topk_select_tensor(const void *buf, rknn_tensor_type type, uint32_t n, uint32_t k, uint32_t *indexes);
+
+#endif /*__TOPK_H__*/
@@ -0,0 +1,139 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "trace.h"
+
+std::atomic<bool> g_trace_enabled(false);
+
+namespace
+{
+struct TraceEvent
+{
+    const char *name;
+    int frame;
+    int64_t begin_us;
+    int64_t dur_us;
+};
+
+struct ThreadBuffer
+{
+    int tid;
+    std::string name;
+    std::vector<std::unique_ptr<TraceEvent[]> > chunks;
+    size_t used;        /* events in the last chunk */
+};
+
+std::mutex g_buffers_mutex;
+std::vector<std::unique_ptr<ThreadBuffer> > g_buffers;
+thread_local ThreadBuffer *t_buffer = NULL;
+
+ThreadBuffer *thread_buffer()
+{
+    if (t_buffer == NULL)
+    {
+        std::lock_guard<std::mutex> lock(g_buffers_mutex);
+        g_buffers.push_back(std::unique_ptr<ThreadBuffer>(new ThreadBuffer()));
+        t_buffer = g_buffers.back().get();
+        t_buffer->tid = g_buffers.size();
+        t_buffer->used = TRACE_CHUNK_EVENTS;
+    }
+    return t_buffer;
+}
+
+void write_escaped(FILE *fp, const char *s)
+{
+    for (; *s; s++)
+    {
+        if (*s == '"' || *s == '\\')
+            fputc('\\', fp);
+        fputc(*s, fp);
+    }
+}
+}
+
+void trace_enable()
+{
+    g_trace_enabled = true;
+}
+
+void trace_thread_name(const std::string &name)
+{
+    if (!trace_enabled())
+        return;
+    thread_buffer()->name = name;
+}
+
+void trace_event(const char *name, int frame, int64_t begin_us, int64_t end_us)
+{
+    ThreadBuffer *b = thread_buffer();
+    if (b->used == TRACE_CHUNK_EVENTS)
+    {
+        b->chunks.push_back(std::unique_ptr<TraceEvent[]>(new TraceEvent[TRACE_CHUNK_EVENTS]));
+        b->used = 0;
+    }
+    TraceEvent &e = b->chunks.back()[b->used++];
+    e.name = name;
+    e.frame = frame;
+    e.begin_us = begin_us;
+    e.dur_us = end_us - begin_us;
+}
+
+int trace_write(const std::string &path)
+{
+    FILE *fp = fopen(path.c_str(), "w");
+    if (fp == NULL)
+    {
+        printf("fopen %s fail!\n", path.c_str());
+        return -1;
+    }
+    std::lock_guard<std::mutex> lock(g_buffers_mutex);
+    size_t events = 0;
+    fprintf(fp, "{\"traceEvents\":[\n");
+    const char *sep = "";
+    for (size_t i = 0; i < g_buffers.size(); i++)
+    {
+        const ThreadBuffer *b = g_buffers[i].get();
+        if (!b->name.empty())
+        {
+            fprintf(fp, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"", sep, b->tid);
+            write_escaped(fp, b->name.c_str());
+            fprintf(fp, "\"}}");
+            sep = ",\n";
+        }
+        for (size_t c = 0; c < b->chunks.size(); c++)
+        {
+            size_t n = c + 1 == b->chunks.size() ? b->used : TRACE_CHUNK_EVENTS;
+            const TraceEvent *e = b->chunks[c].get();
+            for (size_t k = 0; k < n; k++)
+            {
+                fprintf(fp, "%s{\"ph\":\"X\",\"name\":\"", sep);
+                write_escaped(fp, e[k].name);
+                fprintf(fp, "\",\"pid\":1,\"tid\":%d,\"ts\":%lld,\"dur\":%lld,\"args\":{\"frame\":%d}}", b->tid,
+                        (long long)e[k].begin_us, (long long)e[k].dur_us, e[k].frame);
+                sep = ",\n";
+            }
+            events += n;
+        }
+    }
+    fprintf(fp, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    fclose(fp);
+    printf("trace: %llu events from %d threads written to %s\n", (unsigned long long)events,
+           (int)g_buffers.size(), path.c_str());
+    return 0;
+}
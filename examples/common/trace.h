@@ -0,0 +1,69 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+
+#include "stage_stats.h"
+
+/*
+    Timeline recorder writing Chrome trace-event JSON (chrome://tracing,
+    ui.perfetto.dev).
+
+    Every thread appends complete events (name, frame, begin, duration) to
+    its own buffer, so recording takes no lock and no allocation except
+    one chunk per TRACE_CHUNK_EVENTS events. Names must be string literals,
+    only the pointer is stored. Buffers outlive their threads and are
+    written out by trace_write() once the pipeline has stopped.
+*/
+#define TRACE_CHUNK_EVENTS 4096
+
+extern std::atomic<bool> g_trace_enabled;
+
+static inline bool trace_enabled()
+{
+    return g_trace_enabled.load(std::memory_order_relaxed);
+}
+
+void trace_enable();
+/* name the calling thread in the timeline, e.g. "decode 2". */
+void trace_thread_name(const std::string &name);
+void trace_event(const char *name, int frame, int64_t begin_us, int64_t end_us);
+/* write every recorded event to path, 0 on success. */
+int trace_write(const std::string &path);
+
+/* records name for frame from construction to destruction when tracing is enabled. */
+class TraceScope
+{
+public:
+    TraceScope(const char *name, int frame = -1)
+        : name_(name), frame_(frame), begin_us_(trace_enabled() ? get_time_us() : -1)
+    {
+    }
+    ~TraceScope()
+    {
+        if (begin_us_ >= 0)
+            trace_event(name_, frame_, begin_us_, get_time_us());
+    }
+private:
+    const char *name_;
+    int frame_;
+    int64_t begin_us_;
+};
+
+#endif /*__TRACE_H__*/
@@ -0,0 +1,184 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*-------------------------------------------
+                Includes
+-------------------------------------------*/
+#include <stdio.h>
+#include <unistd.h>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+
+#include "result_record.h"
+
+typedef std::map<std::string, ImageResult> ResultMap;
+
+/*-------------------------------------------
+                  Functions
+-------------------------------------------*/
+
+// an image scored by more than one shard counts once, the last result wins
+static int load_results(const char *path, ResultMap &results, int *duplicates)
+{
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        printf("open %s fail!\n", path);
+        return -1;
+    }
+    std::string line;
+    int lines = 0;
+    int bad = 0;
+    while (std::getline(in, line))
+    {
+        ImageResult result;
+        if (line.empty())
+            continue;
+        if (!parse_result(line, &result)) {
+            bad++;
+            continue;
+        }
+        if (results.count(result.name))
+            (*duplicates)++;
+        results[result.name] = result;
+        lines++;
+    }
+    printf("%s: %d results", path, lines);
+    if (bad)
+        printf(", %d malformed lines skipped", bad);
+    printf("\n");
+    return 0;
+}
+
+/* 0 miss, 1 top5 hit, 2 top1 hit */
+static int hit_rank(const ImageResult &r)
+{
+    for (int i = 0; i < r.top_num; i++)
+    {
+        if (r.top[i] == (uint32_t)r.label)
+            return i == 0 ? 2 : 1;
+    }
+    return 0;
+}
+
+// accuracy of this run against a baseline run over the images both scored
+static void print_delta(const ResultMap &baseline, const ResultMap &results)
+{
+    int common = 0;
+    int base_top1 = 0, base_top5 = 0;
+    int top1 = 0, top5 = 0;
+    int changed = 0;
+    for (ResultMap::const_iterator it = results.begin(); it != results.end(); ++it)
+    {
+        ResultMap::const_iterator b = baseline.find(it->first);
+        if (b == baseline.end() || it->second.label < 0)
+            continue;
+        common++;
+        int base_hit = hit_rank(b->second);
+        int hit = hit_rank(it->second);
+        base_top1 += base_hit == 2;
+        base_top5 += base_hit > 0;
+        top1 += hit == 2;
+        top5 += hit > 0;
+        if (b->second.top_num > 0 && it->second.top_num > 0 && b->second.top[0] != it->second.top[0])
+            changed++;
+    }
+    if (common == 0) {
+        printf("no labeled images in common with the baseline\n");
+        return;
+    }
+    std::cout << "===========delta to baseline============\n";
+    std::cout << "Common image count: " << common << "\n";
+    std::cout << "Top1 acc: " << float(base_top1) / common*100 << "% -> " << float(top1) / common*100 << "% (" << float(top1 - base_top1) / common*100 << ")\n";
+    std::cout << "Top5 acc: " << float(base_top5) / common*100 << "% -> " << float(top5) / common*100 << "% (" << float(top5 - base_top5) / common*100 << ")\n";
+    std::cout << "Top1 prediction changed: " << changed << " (" << float(changed) / common*100 << "%)\n";
+    std::cout << "=========================================\n";
+}
+
+/*-------------------------------------------
+                  Main Function
+-------------------------------------------*/
+int main(int argc, char** argv)
+{
+    std::string baseline_file;
+    int res;
+    while((res = getopt(argc, argv, "b:h")) != -1)
+    {
+        switch(res)
+        {
+            case 'b':
+                baseline_file = optarg;
+                break;
+            case 'h':
+            default:
+                optind = argc + 1;
+                break;
+        }
+    }
+    if(optind >= argc)
+    {
+        std::cout << "[Usage]: " << argv[0] << " [-b baseline_file] result_file [result_file ...]\n"
+                  << " \n";
+        return 0;
+    }
+
+    ResultMap results;
+    int duplicates = 0;
+    for (int f = optind; f < argc; f++)
+    {
+        if (load_results(argv[f], results, &duplicates) != 0)
+            return -1;
+    }
+    if (duplicates)
+        printf("%d images appear in more than one file\n", duplicates);
+
+    int image_count = 0;
+    int unlabeled = 0;
+    int top1_count = 0;
+    int top5_count = 0;
+    double npu_ms = 0;
+    for (ResultMap::const_iterator it = results.begin(); it != results.end(); ++it)
+    {
+        const ImageResult &r = it->second;
+        npu_ms += r.npu_ms;
+        if (r.label < 0) {
+            unlabeled++;
+            continue;
+        }
+        image_count++;
+        int hit = hit_rank(r);
+        top1_count += hit == 2;
+        top5_count += hit > 0;
+    }
+    if (unlabeled)
+        printf("%d images without a label ignored\n", unlabeled);
+    if (image_count == 0) {
+        printf("no labeled results\n");
+        return -1;
+    }
+    std::cout << "===========acc test result==============\n";
+    std::cout << "Test Image count: " << image_count << "\nTop1 count: " << top1_count << "\nTop5 count: " << top5_count << "\nTop1 acc: " << float(top1_count) / image_count*100 << "%\nTop5 acc: " << float(top5_count) / image_count*100 << "%\n";
+    std::cout << "avg npu time: " << npu_ms / results.size() << " ms\n";
+    std::cout << "=========================================\n";
+
+    if (!baseline_file.empty()) {
+        ResultMap baseline;
+        int baseline_duplicates = 0;
+        if (load_results(baseline_file.c_str(), baseline, &baseline_duplicates) != 0)
+            return -1;
+        print_delta(baseline, results);
+    }
+    return 0;
+}
@@ -30,12 +30,30 @@
 #include <sstream>
 #include <algorithm>
 #include <assert.h>
+#include <thread>
+#include <memory>
+#include <atomic>
+#include <map>
 
 #include "opencv2/core/core.hpp"
 #include "opencv2/imgproc.hpp"
 #include "opencv2/imgcodecs.hpp"
 
 #include "rknn_api.h"
+#include "bounded_queue.h"
+#include "stage_stats.h"
+#include "decode_pool.h"
+#include "tensor_cache.h"
+#include "topk.h"
+#include "qnt_util.h"
+#include "npu_runner.h"
+#include "image_preprocess.h"
+#include "result_record.h"
+#include "result_journal.h"
+#include "label_index.h"
+#include "trace.h"
+#include "dataset_pack.h"
+#include "model_file.h"
 
 using namespace std;
 using namespace cv;
@@ -44,12 +62,6 @@ using namespace cv;
                   Functions
 -------------------------------------------*/
 
-static void printRKNNTensor(rknn_tensor_attr *attr) {
-    printf("index=%d name=%s n_dims=%d dims=[%d %d %d %d] n_elems=%d size=%d fmt=%d type=%d qnt_type=%d fl=%d zp=%d scale=%f\n", 
-            attr->index, attr->name, attr->n_dims, attr->dims[3], attr->dims[2], attr->dims[1], attr->dims[0], 
-            attr->n_elems, attr->size, 0, attr->type, attr->qnt_type, attr->fl, attr->zp, attr->scale);
-}
-
 std::vector <std::string> read_directory( const std::string& path = std::string() )
 {
     std::vector <std::string> result;
@@ -76,65 +88,578 @@ std::vector <std::string> read_directory( const std::string& path = std::string(
     return result;
 }
 
-static unsigned char *load_model(const char *filename, int *model_size)
+/*-------------------------------------------
+                  Pipeline
+-------------------------------------------*/
+#define PIPELINE_QUEUE_DEPTH 8
+#define NPU_BENCH_FRAMES 100
+#define PROGRESS_INTERVAL_US 1000000
+#define PROFILE_TOP_LAYERS 20
+
+struct PipelineContext
 {
-    FILE *fp = fopen(filename, "rb");
-    if(fp == nullptr) {
-        printf("fopen %s fail!\n", filename);
-        return NULL;
-    }
-    fseek(fp, 0, SEEK_END);
-    int model_len = ftell(fp);
-    unsigned char *model = (unsigned char*)malloc(model_len);
-    fseek(fp, 0, SEEK_SET);
-    if(model_len != fread(model, 1, model_len, fp)) {
-        printf("fread %s fail!\n", filename);
-        free(model);
-        return NULL;
-    }
-    *model_size = model_len;
-    if(fp) {
-        fclose(fp);
-    }
-    return model;
+    PipelineContext(int decode_threads, int npu_contexts)
+        : decode_queue(PIPELINE_QUEUE_DEPTH), tensor_queue(PIPELINE_QUEUE_DEPTH),
+          result_queue(PIPELINE_QUEUE_DEPTH),
+          decode_pool(decode_threads, &decode_queue, &decode_stats),
+          read_stats("read", 1), decode_stats("decode", decode_pool.threads()),
+          preprocess_stats("preprocess", 1), map_stats("map-prep", npu_contexts),
+          npu_stats("npu", npu_contexts), score_stats("score", 1), quantized_scoring(false), zero_copy(false),
+          quiet(false), total_images(0), resumed_images(0), start_us(0), pack(NULL), npu_active(npu_contexts),
+          failed(false)
+    {
+    }
+
+    /* stop every stage, used when one of them hits an error. */
+    void abort()
+    {
+        failed = true;
+        decode_pool.cancel();
+        decode_queue.close();
+        tensor_queue.close();
+        result_queue.close();
+    }
+
+    BoundedQueue<DecodedImage> decode_queue;
+    BoundedQueue<DecodedImage> tensor_queue;
+    BoundedQueue<NpuFrame> result_queue;
+    DecodePool decode_pool;
+    TensorCache tensor_cache;
+    StageStats read_stats;
+    StageStats decode_stats;
+    StageStats preprocess_stats;
+    StageStats map_stats;       /* zero-copy: preprocessing into the mapped input */
+    StageStats npu_stats;
+    StageStats score_stats;
+    /* layout of NpuFrame::outputs per output: raw type with quantized_scoring, else float32. */
+    std::vector<rknn_tensor_attr> output_attrs;
+    bool quantized_scoring;
+    bool zero_copy;
+    bool quiet;                     /* no per-image console output, only a progress line */
+    int total_images;
+    int resumed_images;
+    int64_t start_us;
+    ResultJournal journal;          /* per-image JSON lines, see result_record.h */
+    std::vector<bool> done;         /* images already in the journal when resuming */
+    const DatasetPack *pack;        /* -i names a pack file instead of a directory */
+    std::vector<uint32_t> pack_ids; /* pack entry of every img_list index */
+    std::vector<TensorCache *> sweep_caches;   /* model sweep: one cache per input geometry */
+    std::atomic<int> npu_active;    /* npu stages still running, the last one closes result_queue */
+    std::atomic<bool> failed;
+};
+
+static void reader_stage(PipelineContext *pc, const std::string &image_dir, const std::vector<std::string> &img_list,
+                         int width, int height)
+{
+    trace_thread_name("reader");
+    for (size_t i = 0; i < img_list.size() && !pc->failed; i++)
+    {
+        if (!pc->done.empty() && pc->done[i])
+            continue;
+        int64_t t0 = get_time_us();
+        // cached tensors skip decode and preprocess and go straight to the npu
+        const uint8_t *tensor = pc->tensor_cache.get(i);
+        if (tensor) {
+            DecodedImage item;
+            item.index = i;
+            item.name = img_list[i];
+            item.img = cv::Mat(height, width, CV_8UC3, (void *)tensor);
+            item.rgb = true;
+            pc->read_stats.add(get_time_us() - t0);
+            if (!pc->tensor_queue.push(std::move(item)))
+                break;
+            continue;
+        }
+        // model sweep: cached at every geometry, the preprocessor needs no image
+        bool cached = !pc->sweep_caches.empty();
+        for (size_t g = 0; g < pc->sweep_caches.size() && cached; g++)
+            cached = pc->sweep_caches[g]->contains(i);
+        if (cached) {
+            DecodedImage item;
+            item.index = i;
+            item.name = img_list[i];
+            pc->read_stats.add(get_time_us() - t0);
+            if (!pc->decode_queue.push(std::move(item)))
+                break;
+            continue;
+        }
+        DecodeJob job;
+        job.index = i;
+        job.name = img_list[i];
+        job.path = image_dir + img_list[i];
+        if (pc->pack) {
+            job.mapped = pc->pack->data(pc->pack_ids[i], &job.mapped_size);
+        } else if (!read_file(job.path, job.data)) {
+            printf("read %s fail!\n", job.path.c_str());
+            pc->abort();
+            break;
+        }
+        int64_t t1 = get_time_us();
+        pc->read_stats.add(t1 - t0);
+        if (trace_enabled())
+            trace_event("read", i, t0, t1);
+        if (!pc->decode_pool.submit(std::move(job)))
+            break;
+    }
 }
 
-static int rknn_GetTop
-    (
-    float *pfProb,
-    float *pfMaxProb,
-    uint32_t *pMaxClass,
-    uint32_t outputCount,
-    uint32_t topNum
-    )
+static void preprocess_stage(PipelineContext *pc, int width, int height)
 {
-    uint32_t i, j;
+    trace_thread_name("preprocess");
+    DecodedImage item;
+    while (pc->decode_queue.pop(item))
+    {
+        if(!item.img.data) {
+            pc->abort();
+            break;
+        }
+        // zero-copy: the npu stage resizes straight into the mapped input
+        if (pc->zero_copy) {
+            if (!pc->tensor_queue.push(std::move(item)))
+                break;
+            continue;
+        }
+        int64_t t0 = get_time_us();
+        cv::Mat img(height, width, CV_8UC3);
+        {
+            TraceScope trace("preprocess_to_tensor", item.index);
+            preprocess_to_tensor(item.img, item.rgb, width, height, RKNN_TENSOR_NHWC, img.data);
+        }
+        item.img = img;
+        item.rgb = true;
+        pc->tensor_cache.put(item.index, item.img.data);
+        pc->preprocess_stats.add(get_time_us() - t0);
+        if (!pc->tensor_queue.push(std::move(item)))
+            break;
+    }
+    pc->tensor_queue.close();
+}
 
-    #define MAX_TOP_NUM 20
-    if (topNum > MAX_TOP_NUM) return 0;
+static void npu_stage(PipelineContext *pc, NpuRunner *runner, int context)
+{
+    trace_thread_name("npu " + std::to_string(context));
+    DecodedImage item;
+    NpuFrame frame;
+    int ret = 0;
+    int width = 0, height = 0;
+    rknn_tensor_format fmt = RKNN_TENSOR_NHWC;
+    bool cache_mapped = false;
+    if (pc->zero_copy) {
+        tensor_input_size(&runner->input_attrs()[0], &width, &height);
+        fmt = runner->input_attrs()[0].fmt;
+        // a cache slot holds exactly one tensor of the cache geometry
+        cache_mapped = fmt == RKNN_TENSOR_NHWC && pc->tensor_cache.is_open() &&
+                       pc->tensor_cache.width() == width && pc->tensor_cache.height() == height;
+    }
+    while (ret >= 0 && pc->tensor_queue.pop(item))
+    {
+        int64_t t0 = get_time_us();
+        if (pc->zero_copy) {
+            preprocess_to_tensor(item.img, item.rgb, width, height, fmt, runner->mapped_input());
+            if (!item.rgb && cache_mapped)
+                pc->tensor_cache.put(item.index, runner->mapped_input());
+            int64_t t1 = get_time_us();
+            pc->map_stats.add(t1 - t0);
+            if (trace_enabled())
+                trace_event("preprocess_to_tensor", item.index, t0, t1);
+            ret = runner->run_mapped(item.index, &frame);
+            t0 = t1;
+        } else {
+            ret = runner->run(item.index, item.img.data, item.img.total() * item.img.elemSize(), &frame);
+        }
+        pc->npu_stats.add(get_time_us() - t0);
+        if (ret > 0 && !pc->result_queue.push(std::move(frame)))
+            break;
+    }
+    // async mode: collect the frames still on the npu
+    while (ret >= 0 && !pc->failed && runner->pending() > 0)
+    {
+        ret = runner->flush(&frame);
+        if (ret <= 0 || !pc->result_queue.push(std::move(frame)))
+            break;
+    }
+    if (ret < 0) {
+        pc->abort();
+    }
+    if (--pc->npu_active == 0)
+        pc->result_queue.close();
+}
 
-    memset(pfMaxProb, 0, sizeof(float) * topNum);
-    memset(pMaxClass, 0xff, sizeof(float) * topNum);
+static void print_accuracy(int image_count, int top1_count, int top5_count)
+{
+    std::cout << "===========acc test result==============\n";
+    std::cout << "Test Image count: " << image_count << "\nTop1 count: " << top1_count << "\nTop5 count: " << top5_count << "\nTop1 acc: " << float(top1_count) / image_count*100 << "%\nTop5 acc: " << float(top5_count) / image_count*100 << "%\n";
+    std::cout << "=========================================\n";  
+}
 
-    for (j = 0; j < topNum; j++)
+static void scorer_stage(PipelineContext *pc, const std::string &image_dir, const std::vector<std::string> &img_list,
+                         const LabelIndex *labels, int one_pic_repeat_count, int *top1_count, int *top5_count, int *image_count)
+{
+    trace_thread_name("scorer");
+    NpuFrame result;
+    int64_t progress_us = 0;
+    while (pc->result_queue.pop(result))
     {
-        for (i=0; i<outputCount; i++)
+        TraceScope trace("postprocess", result.tag);
+        int64_t t0 = get_time_us();
+        bool verbose = !pc->quiet;
+        *image_count = *image_count + 1;
+        const std::string &name = img_list[result.tag];
+        // ground truth stored in the pack, else by image name; -1 if unknown
+        int label = pc->pack ? pc->pack->label(pc->pack_ids[result.tag]) : -1;
+        if (label < 0)
+            label = labels->find(name);
+        if (verbose) {
+            std::cout << "test image count: " << *image_count << "\n";
+            std::cout << (image_dir + name) << "\n";
+            std::cout << "\nRepeat " << one_pic_repeat_count << " times, avg time per run is " << result.avg_time << " ms\n"<< "max time is " << result.max_time << " ms, min time is " << result.min_time << " ms\n";
+            std::cout << "--------------------------------------\n";
+            std::cout<<label<<'\n';
+        }
+        // Post Process
+        bool top5=false;
+        bool top1=false;
+        ImageResult record;
+        record.name = name;
+        record.label = label;
+        record.top_num = 0;
+        record.npu_ms = result.avg_time;
+        for (size_t i = 0; i < result.outputs.size(); i++)
         {
-            if ((i == *(pMaxClass+0)) || (i == *(pMaxClass+1)) || (i == *(pMaxClass+2)) ||
-                (i == *(pMaxClass+3)) || (i == *(pMaxClass+4)))
+            uint32_t MaxClass[5];
+            float fMaxProb[5];
+            const rknn_tensor_attr *attr = &pc->output_attrs[i];
+            const uint8_t *buffer = result.outputs[i].data();
+            uint32_t sz = result.outputs[i].size() / tensor_type_size(attr->type);
+
+            // rank in the output's own domain, dequantize only the winners
+            uint32_t top_num = topk_select_tensor(buffer, attr->type, sz, 5, MaxClass);
+            for(uint32_t i=0; i<top_num; i++)
+            {
+                fMaxProb[i] = qnt_dequantize(buffer, MaxClass[i], attr);
+            }
+            if (i == 0) {
+                record.top_num = std::min(top_num, (uint32_t)RESULT_TOP_NUM);
+                for (int k = 0; k < record.top_num; k++) {
+                    record.top[k] = MaxClass[k];
+                    record.score[k] = fMaxProb[k];
+                }
+            }
+
+            if (verbose) {
+                printf(" --- Top5 ---\n");
+                for(uint32_t i=0; i<top_num; i++)
+                {
+                    printf("%3d: %8.6f\n", MaxClass[i], fMaxProb[i]);
+                }
+                std::cout<<label<<'\n';
+            }
+            for(uint32_t i=0; i<top_num; i++)
             {
+                if (i==0 and (int)MaxClass[i]==label){
+                    top1=true;
+                }
+                if ((int)MaxClass[i]==label){ 
+                    top5=true;
+                }
+
+            }
+        }
+        if (top1==true){ 
+            if (verbose)
+                std::cout<<"image:"<< name <<" Top1 is pass " <<label<<'\n';
+            *top1_count=*top1_count+1;
+        }
+        
+        if (top5==true){ 
+            if (verbose)
+	            std::cout<<"image:"<< name <<" Top5 is pass " <<label<<'\n';
+            *top5_count=*top5_count+1;
+        }
+        // a record that does not reach the journal leaves a gap in the shard
+        if (pc->journal.is_open() && pc->journal.append(record) != 0) {
+            pc->abort();
+            break;
+        }
+        if (verbose) {
+            print_accuracy(*image_count, *top1_count, *top5_count);
+        } else if (t0 - progress_us >= PROGRESS_INTERVAL_US) {
+            // quiet mode: one overwritten status line, at most once per interval
+            progress_us = t0;
+            double elapsed_s = (t0 - pc->start_us) / 1000000.0;
+            printf("\r%d/%d images, top1 %.2f%%, top5 %.2f%%, %.1f images/s ", *image_count, pc->total_images,
+                   *top1_count * 100.f / *image_count, *top5_count * 100.f / *image_count,
+                   elapsed_s > 0 ? (*image_count - pc->resumed_images) / elapsed_s : 0.0);
+            fflush(stdout);
+        }
+        pc->score_stats.add(get_time_us() - t0);
+    }
+    if (pc->quiet && progress_us)
+        printf("\n");
+}
+
+/*-------------------------------------------
+                  Model sweep
+-------------------------------------------*/
+/* a distinct model input size, every image is preprocessed once per geometry. */
+struct SweepGeometry
+{
+    SweepGeometry(int w, int h) : width(w), height(h) {}
+    int width;
+    int height;
+    TensorCache cache;
+};
+
+struct SweepModel
+{
+    SweepModel(const std::string &model_name)
+        : name(model_name), geometry(0), top1_count(0), top5_count(0), npu_stats(model_name.c_str(), 1)
+    {
+    }
+
+    std::string name;
+    NpuRunner runner;
+    rknn_tensor_attr output_attr;   /* output 0, as float */
+    int geometry;
+    int top1_count;
+    int top5_count;
+    StageStats npu_stats;
+};
+
+/* one image, resized RGB for every geometry of the sweep. */
+struct SweepItem
+{
+    int index;
+    std::vector<cv::Mat> tensors;
+};
+
+static std::vector<std::string> read_models(const std::string &dir)
+{
+    std::vector<std::string> result;
+    DIR *dp = opendir(dir.c_str());
+    if (!dp)
+        return result;
+    dirent *de;
+    while ((de = readdir(dp)) != NULL)
+    {
+        std::string name = de->d_name;
+        if (name.size() > 5 && name.compare(name.size() - 5, 5, ".rknn") == 0)
+            result.push_back(name);
+    }
+    closedir(dp);
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+static void sweep_preprocess_stage(PipelineContext *pc, std::vector<std::unique_ptr<SweepGeometry> > *geometries,
+                                   BoundedQueue<SweepItem> *sweep_queue)
+{
+    trace_thread_name("preprocess");
+    DecodedImage item;
+    while (!pc->failed && pc->decode_queue.pop(item))
+    {
+        TraceScope trace("preprocess_to_tensor", item.index);
+        int64_t t0 = get_time_us();
+        SweepItem sweep;
+        sweep.index = item.index;
+        for (size_t g = 0; g < geometries->size(); g++)
+        {
+            SweepGeometry *geo = (*geometries)[g].get();
+            const uint8_t *tensor = geo->cache.get(item.index);
+            if (tensor) {
+                sweep.tensors.push_back(cv::Mat(geo->height, geo->width, CV_8UC3, (void *)tensor));
                 continue;
             }
+            if (!item.img.data) {
+                pc->abort();
+                break;
+            }
+            cv::Mat img(geo->height, geo->width, CV_8UC3);
+            preprocess_to_tensor(item.img, item.rgb, geo->width, geo->height, RKNN_TENSOR_NHWC, img.data);
+            geo->cache.put(item.index, img.data);
+            sweep.tensors.push_back(img);
+        }
+        pc->preprocess_stats.add(get_time_us() - t0);
+        if (pc->failed || !sweep_queue->push(std::move(sweep)))
+            break;
+    }
+    sweep_queue->close();
+}
 
-            if (pfProb[i] > *(pfMaxProb+j))
+/* runs every model on each image in turn and scores its top-5 against the label. */
+static void sweep_npu_stage(PipelineContext *pc, std::vector<std::unique_ptr<SweepModel> > *models,
+                            BoundedQueue<SweepItem> *sweep_queue, const std::vector<std::string> &img_list,
+                            const LabelIndex *labels, int *image_count)
+{
+    trace_thread_name("npu");
+    SweepItem item;
+    NpuFrame frame;
+    int64_t progress_us = 0;
+    while (!pc->failed && sweep_queue->pop(item))
+    {
+        int label = pc->pack ? pc->pack->label(pc->pack_ids[item.index]) : -1;
+        if (label < 0)
+            label = labels->find(img_list[item.index]);
+        for (size_t m = 0; m < models->size(); m++)
+        {
+            SweepModel *model = (*models)[m].get();
+            const cv::Mat &img = item.tensors[model->geometry];
+            int64_t t0 = get_time_us();
+            if (model->runner.run(item.index, img.data, img.total() * img.elemSize(), &frame) <= 0) {
+                printf("%s: inference fail!\n", model->name.c_str());
+                pc->abort();
+                break;
+            }
+            model->npu_stats.add(get_time_us() - t0);
+            uint32_t top[5];
+            const rknn_tensor_attr *attr = &model->output_attr;
+            uint32_t sz = frame.outputs[0].size() / tensor_type_size(attr->type);
+            uint32_t top_num = topk_select_tensor(frame.outputs[0].data(), attr->type, sz, 5, top);
+            for (uint32_t k = 0; k < top_num; k++)
             {
-                *(pfMaxProb+j) = pfProb[i];
-                *(pMaxClass+j) = i;
+                if ((int)top[k] == label) {
+                    if (k == 0)
+                        model->top1_count++;
+                    model->top5_count++;
+                    break;
+                }
             }
         }
+        *image_count = *image_count + 1;
+        int64_t now = get_time_us();
+        if (now - progress_us >= PROGRESS_INTERVAL_US) {
+            progress_us = now;
+            double elapsed_s = (now - pc->start_us) / 1000000.0;
+            printf("\r%d/%d images, %.1f images/s ", *image_count, pc->total_images,
+                   elapsed_s > 0 ? *image_count / elapsed_s : 0.0);
+            fflush(stdout);
+        }
     }
+    if (progress_us)
+        printf("\n");
+    // unblock the preprocessor if the npu stopped early
+    sweep_queue->close();
+}
 
-    return 1;
+/*
+    Accuracy of every .rknn in model_dir over one pass of the dataset: each
+    image is read and decoded once, resized once per distinct input
+    geometry and run through all models, so the decode cost of a sweep is
+    that of a single model run.
+*/
+static int model_sweep(const std::string &model_dir, const std::string &image_dir, const std::vector<std::string> &img_list,
+                       const DatasetPack *pack, const std::vector<uint32_t> &pack_ids, const LabelIndex *labels,
+                       int decode_threads, const std::string &cache_dir, int decode_factor, uint32_t init_flags)
+{
+    std::vector<std::string> names = read_models(model_dir);
+    if (names.empty()) {
+        printf("no .rknn model in %s\n", model_dir.c_str());
+        return -1;
+    }
+    if (img_list.empty()) {
+        printf("no images\n");
+        return -1;
+    }
+
+    std::vector<std::unique_ptr<SweepModel> > models;
+    std::vector<std::unique_ptr<SweepGeometry> > geometries;
+    int max_width = 0, max_height = 0;
+    for (size_t m = 0; m < names.size(); m++)
+    {
+        std::string path = model_dir + "/" + names[m];
+        SweepModel *model = new SweepModel(names[m]);
+        models.push_back(std::unique_ptr<SweepModel>(model));
+        // the mapping is dropped right after init, all models stay loaded
+        ModelFile file;
+        if (file.open(path) != 0 || model->runner.init(file.data(), file.size(), init_flags, false) < 0) {
+            return -1;
+        }
+        file.close();
+        printf("model %s, rknn_init %.2f ms\n", path.c_str(), model->runner.init_us() / 1000.0);
+        model->runner.set_want_float(true);
+        const rknn_tensor_attr &in = model->runner.input_attrs()[0];
+        int width = 0, height = 0;
+        tensor_input_size(&in, &width, &height);
+        if (in.n_dims != 4 || (in.fmt == RKNN_TENSOR_NCHW ? in.dims[2] : in.dims[0]) != 3) {
+            printf("%s: input is not a 3 channel image\n", names[m].c_str());
+            return -1;
+        }
+        model->output_attr = model->runner.output_attrs()[0];
+        model->output_attr.type = RKNN_TENSOR_FLOAT32;
+        model->output_attr.qnt_type = RKNN_TENSOR_QNT_NONE;
+        // models sharing an input size share its preprocessed tensors
+        size_t g = 0;
+        while (g < geometries.size() && (geometries[g]->width != width || geometries[g]->height != height))
+            g++;
+        if (g == geometries.size())
+            geometries.push_back(std::unique_ptr<SweepGeometry>(new SweepGeometry(width, height)));
+        model->geometry = g;
+        max_width = std::max(max_width, width);
+        max_height = std::max(max_height, height);
+        printf("  input %dx%d, geometry %d\n", width, height, (int)g);
+    }
+
+    PipelineContext pc(decode_threads, 1);
+    if (pack) {
+        pc.pack = pack;
+        pc.pack_ids = pack_ids;
+    }
+    for (size_t g = 0; g < geometries.size(); g++)
+    {
+        SweepGeometry *geo = geometries[g].get();
+        if (!cache_dir.empty()) {
+            std::string cache_file = tensor_cache_path(cache_dir, geo->width, geo->height, 3, decode_factor);
+            if (geo->cache.open(cache_file, geo->width, geo->height, 3, img_list) != 0) {
+                return -1;
+            }
+            pc.sweep_caches.push_back(&geo->cache);
+        }
+    }
+    // the reduced decode has to cover the largest input of the sweep
+    pc.decode_pool.set_reduced_decode(max_width, max_height, decode_factor);
+    printf("sweep: %d models, %d input geometries, %d images, decode threads: %d\n", (int)models.size(),
+           (int)geometries.size(), (int)img_list.size(), pc.decode_pool.threads());
+
+    BoundedQueue<SweepItem> sweep_queue(PIPELINE_QUEUE_DEPTH);
+    int image_count = 0;
+    pc.total_images = img_list.size();
+    int64_t start_us = get_time_us();
+    pc.start_us = start_us;
+    pc.decode_pool.start();
+    std::thread reader(reader_stage, &pc, image_dir, std::cref(img_list), 0, 0);
+    std::thread preprocessor(sweep_preprocess_stage, &pc, &geometries, &sweep_queue);
+    std::thread npu(sweep_npu_stage, &pc, &models, &sweep_queue, std::cref(img_list), labels, &image_count);
+    reader.join();
+    pc.decode_pool.finish();
+    pc.decode_queue.close();
+    preprocessor.join();
+    npu.join();
+    int64_t wall_us = get_time_us() - start_us;
+
+    std::vector<StageStats *> stages;
+    stages.push_back(&pc.read_stats);
+    stages.push_back(&pc.decode_stats);
+    stages.push_back(&pc.preprocess_stats);
+    for (size_t m = 0; m < models.size(); m++)
+        stages.push_back(&models[m]->npu_stats);
+    print_stage_report(stages, wall_us);
+    pc.decode_pool.print_report();
+    for (size_t g = 0; g < geometries.size(); g++)
+        geometries[g]->cache.print_report();
+    if (pc.failed || image_count == 0)
+        return -1;
+
+    printf("===========sweep result: %d images==============\n", image_count);
+    printf("%-40s %9s %9s %9s\n", "model", "Top1", "Top5", "npu ms");
+    for (size_t m = 0; m < models.size(); m++)
+    {
+        const SweepModel *model = models[m].get();
+        printf("%-40s %8.2f%% %8.2f%% %9.2f\n", model->name.c_str(), model->top1_count * 100.f / image_count,
+               model->top5_count * 100.f / image_count,
+               model->npu_stats.items() ? model->npu_stats.busy_us() / 1000.0 / model->npu_stats.items() : 0.0);
+    }
+    printf("=========================================\n");
+    return 0;
 }
 
 /*-------------------------------------------
@@ -142,18 +667,29 @@ static int rknn_GetTop
 -------------------------------------------*/
 int main(int argc, char** argv)
 {
-    const int MODEL_IN_WIDTH = 224;
-    const int MODEL_IN_HEIGHT = 224;
     const int MODEL_IN_CHANNELS = 3;
     std::string image_dir="./images/val/";
     int image_count = 0;
     int repeat_count = 50000;
-    rknn_context ctx;
-    int ret;
+    int decode_threads = 0;
+    std::string cache_dir;
+    bool quantized_scoring = false;
+    bool async_mode = false;
+    bool zero_copy = false;
+    int npu_contexts = 1;
+    uint32_t priority_flag = RKNN_FLAG_PRIOR_HIGH;
+    int shard_index = 0;
+    int shard_count = 1;
+    std::string result_path;
+    bool resume = false;
+    bool quiet = false;
+    int profile_every = 0;
+    std::string trace_path;
+    int decode_factor = 1;
+    std::string model_dir;
     int res;
-    int model_len = 0;
-    unsigned char *model;
     std::string val_file="val.txt";
+    bool val_given = false;
     std::string model_file="./models/AT/SqueezeNet1.0-0000.params";
     int one_pic_repeat_count = 1;
     const char* one_pic_repeat = std::getenv("ONE_PIC_REPEAT_COUNT");
@@ -163,11 +699,11 @@ int main(int argc, char** argv)
     if(argc == 1)
     {
         std::cout << "[Usage]: " << argv[0] << " [-h]\n"
-                  << "[-m model_file] [-i image_dir] [-v val_file] [-r repeat_count]\n"
+                  << "[-m model_file] [-i image_dir] [-v val_file] [-r repeat_count] [-j decode_threads] [-c cache_dir] [-Q] [-a] [-z] [-n contexts] [-p high|medium|low] [-s shard/shards] [-o result_file] [-R] [-q] [-P every_n] [-T trace_file] [-d 1|2|4|8] [-M model_dir]\n"
                   << " \n";
         return 0;
     }
-    while((res = getopt(argc, argv, "m:i:v:r:h")) != -1)
+    while((res = getopt(argc, argv, "m:i:v:r:j:c:Qazn:p:s:o:RqP:T:d:M:h")) != -1)
     {
         switch(res)
         {
@@ -179,227 +715,328 @@ int main(int argc, char** argv)
                 break;
            case 'v':
                 val_file = optarg;
+                val_given = true;
                 break;
             case 'r':
                 repeat_count = std::strtoul(optarg, NULL, 10);
                 break;
+            case 'j':
+                decode_threads = std::strtoul(optarg, NULL, 10);
+                break;
+            case 'c':
+                cache_dir = optarg;
+                break;
+            case 'Q':
+                quantized_scoring = true;
+                break;
+            case 'a':
+                async_mode = true;
+                break;
+            case 'z':
+                zero_copy = true;
+                break;
+            case 'n':
+                npu_contexts = std::max(1, atoi(optarg));
+                break;
+            case 'p':
+                if (npu_priority_flag(optarg, &priority_flag) < 0) {
+                    printf("unknown priority %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 's':
+                if (parse_shard(optarg, &shard_index, &shard_count) < 0) {
+                    return -1;
+                }
+                break;
+            case 'o':
+                result_path = optarg;
+                break;
+            case 'R':
+                resume = true;
+                break;
+            case 'q':
+                quiet = true;
+                break;
+            case 'P':
+                profile_every = std::max(1, atoi(optarg));
+                break;
+            case 'T':
+                trace_path = optarg;
+                trace_enable();
+                break;
+            case 'd':
+                decode_factor = atoi(optarg);
+                if (decode_factor != 1 && decode_factor != 2 && decode_factor != 4 && decode_factor != 8) {
+                    printf("decode factor must be 1, 2, 4 or 8\n");
+                    return -1;
+                }
+                break;
+            case 'M':
+                model_dir = optarg;
+                break;
             case 'h':
                 std::cout << "[Usage]: " << argv[0] << " [-h]\n"
-                          << "[-m model_file] [-i image_dir] [-v val_file] [-r repeat_count]\n"
+                          << "[-m model_file] [-i image_dir] [-v val_file] [-r repeat_count] [-j decode_threads] [-c cache_dir] [-Q] [-a] [-z] [-n contexts] [-p high|medium|low] [-s shard/shards] [-o result_file] [-R] [-q] [-P every_n] [-T trace_file] [-d 1|2|4|8] [-M model_dir]\n"
                           << "\n";
                 return 0;
             default:
                 break;
         }
     }
-    // Load RKNN Model
-    model = load_model(model_file.c_str(), &model_len);
-    ret = rknn_init(&ctx, model, model_len, 0);
-    if(ret < 0) {
-        printf("rknn_init fail! ret=%d\n", ret);
-        return -1;
+    // Load image
+    // a pack file replaces the directory scan and carries its own labels
+    DatasetPack pack;
+    std::vector<std::string> img_list;
+    std::vector<uint32_t> pack_ids;
+    if (is_dataset_pack(image_dir)) {
+        if (pack.open(image_dir) != 0) {
+            return -1;
+        }
+        img_list = pack.names();
+        for (size_t i = 0; i < img_list.size(); i++) {
+            pack_ids.push_back(i);
+        }
+    } else {
+        img_list = read_directory(image_dir);
     }
-
-    // Get Model Input Output Info
-    rknn_input_output_num io_num;
-    ret = rknn_query(ctx, RKNN_QUERY_IN_OUT_NUM, &io_num, sizeof(io_num));
-    if (ret != RKNN_SUCC) {
-        printf("rknn_query fail! ret=%d\n", ret);
+    // val.txt: "<image name> <label>" per line
+    LabelIndex labels;
+    if ((!pack.is_open() || val_given) && labels.open(val_file) != 0) {
         return -1;
     }
-    printf("model input num: %d, output num: %d\n", io_num.n_input, io_num.n_output);
+    int top1_count = 0;
+    int top5_count = 0;
+    if ((int)img_list.size() > repeat_count) {
+        img_list.resize(repeat_count);
+        if (pack.is_open())
+            pack_ids.resize(repeat_count);
+    }
+    if (shard_count > 1) {
+        select_shard(img_list, shard_index, shard_count);
+        select_shard(pack_ids, shard_index, shard_count);
+        printf("shard %d/%d: %d images\n", shard_index, shard_count, (int)img_list.size());
+    }
 
-    printf("input tensors:\n");
-    rknn_tensor_attr input_attrs[io_num.n_input];
-    memset(input_attrs, 0, sizeof(input_attrs));
-    for (int i = 0; i < io_num.n_input; i++) {
-        input_attrs[i].index = i;
-        ret = rknn_query(ctx, RKNN_QUERY_INPUT_ATTR, &(input_attrs[i]), sizeof(rknn_tensor_attr));
-        if (ret != RKNN_SUCC) {
-            printf("rknn_query fail! ret=%d\n", ret);
-            return -1;
-        }
-        printRKNNTensor(&(input_attrs[i]));
+    if (!model_dir.empty()) {
+        int ret = model_sweep(model_dir, image_dir, img_list, pack.is_open() ? &pack : NULL, pack_ids, &labels,
+                              decode_threads, cache_dir, decode_factor, priority_flag);
+        if (!trace_path.empty())
+            trace_write(trace_path);
+        return ret;
     }
 
-    printf("output tensors:\n");
-    rknn_tensor_attr output_attrs[io_num.n_output];
-    memset(output_attrs, 0, sizeof(output_attrs));
-    for (int i = 0; i < io_num.n_output; i++) {
-        output_attrs[i].index = i;
-        ret = rknn_query(ctx, RKNN_QUERY_OUTPUT_ATTR, &(output_attrs[i]), sizeof(rknn_tensor_attr));
-        if (ret != RKNN_SUCC) {
-            printf("rknn_query fail! ret=%d\n", ret);
+    // Load RKNN Model
+    ModelFile model;
+    if (model.open(model_file) != 0) {
+        return -1;
+    }
+    uint32_t init_flags = priority_flag | (async_mode ? RKNN_FLAG_ASYNC_MASK : 0);
+    if (profile_every > 0)
+        init_flags |= RKNN_FLAG_COLLECT_PERF_MASK;
+    // every context gets its own copy of the model on the npu, attrs are printed once
+    std::vector<std::unique_ptr<NpuRunner> > runners;
+    for (int n = 0; n < npu_contexts; n++) {
+        runners.push_back(std::unique_ptr<NpuRunner>(new NpuRunner()));
+        if (runners[n]->init(model.data(), model.size(), init_flags, n == 0) < 0) {
             return -1;
         }
-        printRKNNTensor(&(output_attrs[i]));
+        runners[n]->set_repeat(one_pic_repeat_count);
+    }
+    // every context holds its own copy, the blob is not needed for the run
+    model.close();
+    NpuRunner &runner = *runners[0];
+    printf("npu contexts: %d\n", npu_contexts);
+    if (async_mode && one_pic_repeat_count > 1) {
+        printf("async mode runs every image once, ONE_PIC_REPEAT_COUNT ignored\n");
+        one_pic_repeat_count = 1;
     }
+    const rknn_input_output_num &io_num = runner.io_num();
+    const std::vector<rknn_tensor_attr> &output_attrs = runner.output_attrs();
+    // input size from the model: every stage, the cache and the decode factor follow it
+    int model_width = 0, model_height = 0;
+    tensor_input_size(&runner.input_attrs()[0], &model_width, &model_height);
+    printf("model input: %dx%d\n", model_width, model_height);
 
-    // Load image
-    int val[50000];
-    std::string image_file;
-    std::string val_data=val_file;
-//std::ofstream f(val_data,std::ios::in);
-    std::ifstream f(val_data);
-    if (!f.is_open()) // 检查文件是否成功打开  
-    	std::cout << "cannot open val file.\n" ;
-    std::string lineStr;
-    int i=0;
-    int j;
-    char* end;
-    //read val.txt
-    while (std::getline(f, lineStr))
-    {
-        j=0;
-        std::stringstream ss(lineStr);  
-        std::string str;
-        while (getline(ss, str, ' '))  
-        {
-            if (j==0){
-                j++;
-                continue;
+    // Pipeline: reader -> decoder pool -> preprocessor -> npu -> scorer
+    PipelineContext pc(decode_threads, npu_contexts);
+    if (pack.is_open()) {
+        pc.pack = &pack;
+        pc.pack_ids = pack_ids;
+    }
+    // per output from its attrs: raw when it can be ranked in its own type, else dequantized by the driver
+    std::vector<bool> output_float(io_num.n_output);
+    bool any_raw = false;
+    for (uint32_t i = 0; i < io_num.n_output; i++) {
+        rknn_tensor_attr attr = output_attrs[i];
+        bool raw = quantized_scoring && attr.type != RKNN_TENSOR_FLOAT32;
+        if (raw && !qnt_preserves_order(&attr)) {
+            printf("output %d: dequantization does not preserve order, scoring in float\n", i);
+            raw = false;
         }
-	   //std::cout <<str<< std::endl;
-            val[i]=static_cast<int>(strtol(str.c_str(),&end,10));              //string -> int
-            j++;
+        if (!raw) {
+            attr.type = RKNN_TENSOR_FLOAT32;
+            attr.qnt_type = RKNN_TENSOR_QNT_NONE;
         }
-        i++;
+        output_float[i] = !raw;
+        any_raw = any_raw || raw;
+        pc.output_attrs.push_back(attr);
     }
-    int top1_count = 0;
-    int top5_count = 0;
-    std::vector <std::string> img_list=read_directory(image_dir);
-    for (std::string image :img_list)
-    {
-        image_count = image_count + 1;
-        if (image_count > repeat_count)
-        {
-            image_count=image_count-1;
-            break;
+    quantized_scoring = any_raw;
+    pc.quantized_scoring = quantized_scoring;
+    if (zero_copy) {
+        if (!tensor_accepts_raw_rgb(&runner.input_attrs()[0])) {
+            printf("input tensor is not raw uint8, zero-copy disabled\n");
+        } else {
+            pc.zero_copy = true;
+            for (size_t n = 0; n < runners.size() && pc.zero_copy; n++) {
+                if (runners[n]->map_input() < 0)
+                    pc.zero_copy = false;
+            }
         }
-        
-        std::cout << "test image count: " << image_count << "\n";
-        image_file=(std::string(image_dir)+std::string(image));
-        std::cout << image_file.c_str() << "\n";
-        cv::Mat orig_img = imread(image_file, cv::IMREAD_COLOR);
-        if(!orig_img.data) {
-            printf("cv::imread %s fail!\n", image_file);
+    }
+    LayerProfile layer_profile;
+    for (size_t n = 0; n < runners.size(); n++) {
+        for (uint32_t i = 0; i < io_num.n_output; i++)
+            runners[n]->set_want_float(i, output_float[i]);
+        if (profile_every > 0)
+            runners[n]->set_profile(&layer_profile, profile_every);
+    }
+    printf("scoring: %s\n", quantized_scoring ? "quantized outputs" : "float outputs");
+    printf("decode threads: %d\n", pc.decode_pool.threads());
+    pc.decode_pool.set_reduced_decode(model_width, model_height, decode_factor);
+    if (resume && result_path.empty()) {
+        printf("-R needs the result file of the interrupted run (-o)\n");
+        return -1;
+    }
+    if (!result_path.empty()) {
+        if (pc.journal.open(result_path, resume) != 0) {
             return -1;
         }
-
-        cv::Mat img = orig_img.clone();
-        if(orig_img.cols != MODEL_IN_WIDTH || orig_img.rows != MODEL_IN_HEIGHT) {
-            printf("resize %d %d to %d %d\n", orig_img.cols, orig_img.rows, MODEL_IN_WIDTH, MODEL_IN_HEIGHT);
-            cv::resize(orig_img, img, cv::Size(MODEL_IN_WIDTH, MODEL_IN_HEIGHT), (0, 0), (0, 0), cv::INTER_LINEAR);
+        // reload the finished images: skip them and restore the counters
+        std::map<std::string, int> index;
+        for (size_t i = 0; i < img_list.size(); i++) {
+            index[img_list[i]] = i;
         }
-
-        cv::cvtColor(img, img, COLOR_BGR2RGB);
-        // Set Input Data
-        rknn_input inputs[1];
-        memset(inputs, 0, sizeof(inputs));
-        inputs[0].index = 0;
-        inputs[0].type = RKNN_TENSOR_UINT8;
-        inputs[0].size = img.cols*img.rows*img.channels();
-        inputs[0].fmt = RKNN_TENSOR_NHWC;
-        inputs[0].buf = img.data;
-
-        ret = rknn_inputs_set(ctx, io_num.n_input, inputs);
-        if(ret < 0) {
-            printf("rknn_input_set fail! ret=%d\n", ret);
-            return -1;
-        }
-        struct timeval t0, t1;
-        float avg_time = 0.f;
-        float min_time = __DBL_MAX__;
-        float max_time = -__DBL_MAX__;
-        for (int e = 0 ; e < one_pic_repeat_count; e++)
-        {
-            gettimeofday(&t0, NULL);
-            // Run
-            printf("rknn_run\n");
-            ret = rknn_run(ctx, nullptr);
-            gettimeofday(&t1, NULL);
-            if(ret < 0) {
-                printf("rknn_run fail! ret=%d\n", ret);
-                return -1;
+        const std::vector<ImageResult> &loaded = pc.journal.loaded();
+        pc.done.assign(img_list.size(), false);
+        for (size_t i = 0; i < loaded.size(); i++) {
+            std::map<std::string, int>::iterator it = index.find(loaded[i].name);
+            if (it == index.end() || pc.done[it->second])
+                continue;
+            pc.done[it->second] = true;
+            image_count++;
+            for (int k = 0; k < loaded[i].top_num; k++) {
+                if ((int)loaded[i].top[k] == loaded[i].label) {
+                    if (k == 0)
+                        top1_count++;
+                    top5_count++;
+                    break;
+                }
             }
-            float mytime = ( float )((t1.tv_sec * 1000000 + t1.tv_usec) - (t0.tv_sec * 1000000 + t0.tv_usec)) / 1000;
-            avg_time += mytime;
-            min_time = std::min(min_time, mytime);
-            max_time = std::max(max_time, mytime);
-        }
-        std::cout << "\nRepeat " << one_pic_repeat_count << " times, avg time per run is " << avg_time / one_pic_repeat_count << " ms\n"<< "max time is " << max_time << " ms, min time is " << min_time << " ms\n";
-        std::cout << "--------------------------------------\n";
-        // Get Output
-        rknn_output outputs[1];
-        memset(outputs, 0, sizeof(outputs));
-        outputs[0].want_float = 1;
-        ret = rknn_outputs_get(ctx, 1, outputs, NULL);
-        if(ret < 0) {
-            printf("rknn_outputs_get fail! ret=%d\n", ret);
+        }
+        if (resume)
+            printf("resume: %d of %d images already scored\n", image_count, (int)img_list.size());
+    }
+    pc.quiet = quiet;
+    pc.total_images = img_list.size();
+    pc.resumed_images = image_count;
+    if (!cache_dir.empty()) {
+        // reduced decoding yields different tensors, keep them apart
+        std::string cache_file = tensor_cache_path(cache_dir, model_width, model_height, MODEL_IN_CHANNELS,
+                                                   decode_factor);
+        if (pc.tensor_cache.open(cache_file, model_width, model_height, MODEL_IN_CHANNELS, img_list) != 0) {
             return -1;
         }
-        //val.txt file_id
-        j=0;
-        std::stringstream ss1(image);
-        std::string str1;
-        int file_id=0;
-        while(getline(ss1,str1,'_')){
-            if (j==2){
-             file_id=static_cast<int>(strtol(str1.c_str(),&end,10));}
-            j++;
-        }
-        std::cout<<file_id<<'\n';
-        // Post Process
-        bool top5=false;
-        bool top1=false;
-        for (int i = 0; i < io_num.n_output; i++)
-        {
-            uint32_t MaxClass[5];
-            float fMaxProb[5];
-            float *buffer = (float *)outputs[i].buf;
-            uint32_t sz = outputs[i].size/4;
-
-            rknn_GetTop(buffer, fMaxProb, MaxClass, sz, 5);
-
-            printf(" --- Top5 ---\n");
-            for(int i=0; i<5; i++)
-            {
-                printf("%3d: %8.6f\n", MaxClass[i], fMaxProb[i]);
-            }
-            std::cout<<file_id<<'\n';
-            for(int i=0; i<5; i++)
-            {
-                if (i==0 and MaxClass[i]==val[file_id-1]){
-                    top1=true;
+        if (pc.zero_copy) {
+            for (size_t n = 0; n < runners.size(); n++) {
+                int width = 0, height = 0;
+                tensor_input_size(&runners[n]->input_attrs()[0], &width, &height);
+                if (width != model_width || height != model_height) {
+                    printf("zero-copy input %dx%d does not match the %dx%d tensor cache, -z and -c cannot be combined\n",
+                           width, height, model_width, model_height);
+                    return -1;
                 }
-                if (MaxClass[i]==val[file_id-1]){ 
-                    top5=true;
-                }
-
             }
         }
-        if (top1==true){ 
-            std::cout<<"file_id:"<< file_id <<" Top1 is pass " <<val[file_id-1]<<'\n';
-            top1_count=top1_count+1;
-        }
-        
-        if (top5==true){ 
-	        std::cout<<"file_id:"<< file_id <<" Top5 is pass " <<val[file_id-1]<<'\n';
-            top5_count=top5_count+1;
-        }
-        std::cout << "===========acc test result==============\n";
-        std::cout << "Test Image count: " << image_count << "\nTop1 count: " << top1_count << "\nTop5 count: " << top5_count << "\nTop1 acc: " << float(top1_count) / image_count*100 << "%\nTop5 acc: " << float(top5_count) / image_count*100 << "%\n";
-        std::cout << "=========================================\n";  
-        // Release rknn_outputs
-        rknn_outputs_release(ctx, 1, outputs);
-    } 
+    }
+    int64_t start_us = get_time_us();
+    pc.start_us = start_us;
+    pc.decode_pool.start();
+    std::thread reader(reader_stage, &pc, image_dir, std::cref(img_list), model_width, model_height);
+    std::thread preprocessor(preprocess_stage, &pc, model_width, model_height);
+    std::vector<std::thread> npu;
+    for (size_t n = 0; n < runners.size(); n++) {
+        npu.push_back(std::thread(npu_stage, &pc, runners[n].get(), (int)n));
+    }
+    std::thread scorer(scorer_stage, &pc, image_dir, std::cref(img_list), &labels, one_pic_repeat_count,
+                       &top1_count, &top5_count, &image_count);
+    reader.join();
+    pc.decode_pool.finish();
+    pc.decode_queue.close();
+    preprocessor.join();
+    for (size_t n = 0; n < npu.size(); n++) {
+        npu[n].join();
+    }
+    scorer.join();
+    int64_t wall_us = get_time_us() - start_us;
+    if (pc.journal.close() != 0) {
+        printf("result file %s is incomplete\n", result_path.c_str());
+        pc.failed = true;
+    }
+    if (!trace_path.empty())
+        trace_write(trace_path);
+    if (quiet && image_count > 0) {
+        print_accuracy(image_count, top1_count, top5_count);
+    }
+
+    std::vector<StageStats *> stages;
+    stages.push_back(&pc.read_stats);
+    stages.push_back(&pc.decode_stats);
+    stages.push_back(&pc.preprocess_stats);
+    if (pc.zero_copy)
+        stages.push_back(&pc.map_stats);
+    stages.push_back(&pc.npu_stats);
+    stages.push_back(&pc.score_stats);
+    print_stage_report(stages, wall_us);
+    for (size_t n = 0; n < runners.size(); n++) {
+        if (runners.size() > 1)
+            printf("context %d:\n", (int)n);
+        runners[n]->print_report();
+    }
+    if (profile_every > 0)
+        layer_profile.print_report(PROFILE_TOP_LAYERS);
+    pc.decode_pool.print_report();
+    pc.tensor_cache.print_report();
+    print_queue_report("decode", pc.decode_queue.stats());
+    print_queue_report("tensor", pc.tensor_queue.stats());
+    print_queue_report("result", pc.result_queue.stats());
 
     // Release
-    if(ctx >= 0) {
-        rknn_destroy(ctx);
+    runners.clear();
+    // the benchmarks create fresh contexts, map the model again for them
+    bool benchmark = !pc.failed && (async_mode || npu_contexts > 1);
+    if (benchmark && model.open(model_file) != 0)
+        benchmark = false;
+    if (async_mode && benchmark) {
+        // same model, blank input: isolates the npu submission mode
+        float sync_fps = npu_benchmark_fps(model.data(), model.size(), priority_flag, NPU_BENCH_FRAMES);
+        float async_fps = npu_benchmark_fps(model.data(), model.size(), priority_flag | RKNN_FLAG_ASYNC_MASK, NPU_BENCH_FRAMES);
+        printf("npu throughput over %d frames: sync %.2f fps, async %.2f fps, gain %.1f%%\n",
+               NPU_BENCH_FRAMES, sync_fps, async_fps, sync_fps > 0 ? (async_fps / sync_fps - 1) * 100 : 0.f);
     }
-    if(model) {
-        free(model);
+    if (npu_contexts > 1 && benchmark) {
+        // throughput vs number of contexts, the flat part is where the driver saturates
+        float base_fps = 0;
+        for (int n = 1; n <= npu_contexts; n++) {
+            float fps = npu_benchmark_fps(model.data(), model.size(), init_flags & ~RKNN_FLAG_COLLECT_PERF_MASK, NPU_BENCH_FRAMES, n);
+            if (n == 1)
+                base_fps = fps;
+            printf("npu throughput with %d contexts: %.2f fps, x%.2f\n", n, fps, base_fps > 0 ? fps / base_fps : 0.f);
+        }
+    }
+    if (pc.failed) {
+        return -1;
     }
     return 0;
 }
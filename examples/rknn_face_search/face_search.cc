@@ -0,0 +1,120 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*-------------------------------------------
+                Includes
+-------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "face_search.h"
+#include "label_index.h"
+
+/*-------------------------------------------
+                  Main Function
+-------------------------------------------*/
+int main(int argc, char** argv)
+{
+    std::string store_file;
+    std::string list_name;
+    std::string label_file;
+    std::string precision = "fp32";
+    int threads = 0;
+    uint32_t topk = 5;
+    int res;
+    while((res = getopt(argc, argv, "f:l:v:q:t:k:h")) != -1)
+    {
+        switch(res)
+        {
+            case 'f':
+                store_file = optarg;
+                break;
+            case 'l':
+                list_name = optarg;
+                break;
+            case 'v':
+                label_file = optarg;
+                break;
+            case 'q':
+                precision = optarg;
+                break;
+            case 't':
+                threads = std::strtoul(optarg, NULL, 10);
+                break;
+            case 'k':
+                topk = std::strtoul(optarg, NULL, 10);
+                break;
+            case 'h':
+            default:
+                store_file.clear();
+                optind = argc;
+                break;
+        }
+    }
+    if (store_file.empty() || list_name.empty() || label_file.empty())
+    {
+        std::cout << "[Usage]: " << argv[0] << " -f feature_store -l list_name -v label_file [-q fp32|int8] [-t threads] [-k topk]\n"
+                  << "  searches every image of the store against all others and reports the rank-1 and\n"
+                  << "  rank-5 identification accuracy, label_file lists \"<image name> <identity>\" per line\n"
+                  << " \n";
+        return 0;
+    }
+    if (precision != "fp32" && precision != "int8") {
+        printf("unknown precision %s\n", precision.c_str());
+        return -1;
+    }
+
+    std::ifstream list_stream(list_name);
+    if (!list_stream.is_open()) {
+        printf("open %s fail!\n", list_name.c_str());
+        return -1;
+    }
+    LabelIndex label_index;
+    if (label_index.open(label_file) != 0) {
+        return -1;
+    }
+    std::vector<int> labels;
+    std::string image_name;
+    while (std::getline(list_stream, image_name))
+    {
+        labels.push_back(label_index.find(image_name));
+    }
+    label_index.close();
+
+    FeatureStore store;
+    if (store.open(store_file) != 0) {
+        return -1;
+    }
+    if (store.count() != labels.size()) {
+        printf("%s holds %d features for %d images\n", store_file.c_str(), (int)store.count(), (int)labels.size());
+        return -1;
+    }
+    // tiles are streamed out of the mapping, no resident copy of the features
+    std::vector<TopkEntry<float> > hits;
+    SearchStats stats;
+    if (search_store(store, precision == "int8", threads, topk, &hits, &stats) != 0) {
+        return -1;
+    }
+    uint32_t dim = store.dim();
+    store.close();
+    IdentifyReport report;
+    identify_accuracy(hits, topk, labels, &report);
+    print_identify_report(report, stats, dim);
+    return 0;
+}
@@ -0,0 +1,81 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*-------------------------------------------
+                Includes
+-------------------------------------------*/
+#include <stdio.h>
+#include <unistd.h>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "face_match.h"
+
+/*-------------------------------------------
+                  Main Function
+-------------------------------------------*/
+int main(int argc, char** argv)
+{
+    std::string store_file;
+    std::string list_name;
+    std::string pairs_file;
+    std::string roc_file;
+    int res;
+    while((res = getopt(argc, argv, "f:l:p:r:h")) != -1)
+    {
+        switch(res)
+        {
+            case 'f':
+                store_file = optarg;
+                break;
+            case 'l':
+                list_name = optarg;
+                break;
+            case 'p':
+                pairs_file = optarg;
+                break;
+            case 'r':
+                roc_file = optarg;
+                break;
+            case 'h':
+            default:
+                store_file.clear();
+                optind = argc;
+                break;
+        }
+    }
+    if (store_file.empty() || list_name.empty() || pairs_file.empty())
+    {
+        std::cout << "[Usage]: " << argv[0] << " -f feature_store -l list_name -p pairs_file [-r roc_file]\n"
+                  << "  scores every \"<image a> <image b> <1|0>\" line of pairs_file (1: same identity)\n"
+                  << "  with the features of the images in the store, row n being image n of list_name\n"
+                  << " \n";
+        return 0;
+    }
+
+    std::ifstream list_stream(list_name);
+    if (!list_stream.is_open()) {
+        printf("open %s fail!\n", list_name.c_str());
+        return -1;
+    }
+    std::vector<std::string> img_list;
+    std::string image_name;
+    while (std::getline(list_stream, image_name))
+    {
+        img_list.push_back(image_name);
+    }
+    return verify_store(store_file, img_list, pairs_file, roc_file);
+}
@@ -0,0 +1,87 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*-------------------------------------------
+                Includes
+-------------------------------------------*/
+#include <stdio.h>
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "feature_store.h"
+
+/*-------------------------------------------
+                  Main Function
+-------------------------------------------*/
+int main(int argc, char** argv)
+{
+    std::string input_file;
+    std::string output_file;
+    int res;
+    while((res = getopt(argc, argv, "i:o:h")) != -1)
+    {
+        switch(res)
+        {
+            case 'i':
+                input_file = optarg;
+                break;
+            case 'o':
+                output_file = optarg;
+                break;
+            case 'h':
+            default:
+                input_file.clear();
+                optind = argc;
+                break;
+        }
+    }
+    if (input_file.empty() || output_file.empty())
+    {
+        std::cout << "[Usage]: " << argv[0] << " -i feature_store -o text_file\n"
+                  << "  writes the rows of a binary feature store as the legacy text format,\n"
+                  << "  one line per image of \"%.8f\\t\" values\n"
+                  << " \n";
+        return 0;
+    }
+
+    FeatureStore store;
+    if (store.open(input_file) != 0) {
+        return -1;
+    }
+    FILE *fp = fopen(output_file.c_str(), "w");
+    if (fp == NULL) {
+        printf("open %s fail!\n", output_file.c_str());
+        return -1;
+    }
+    std::vector<float> row(store.dim());
+    for (size_t n = 0; n < store.count(); n++)
+    {
+        store.row_float(n, row.data());
+        for (uint32_t i = 0; i < store.dim(); i++)
+        {
+            fprintf(fp, "%.8f\t", row[i]);
+        }
+        fputc('\n', fp);
+    }
+    if (fclose(fp) != 0) {
+        printf("write %s fail!\n", output_file.c_str());
+        return -1;
+    }
+    printf("%s: %d x %d %s%s -> %s\n", input_file.c_str(), (int)store.count(), store.dim(),
+           store.type() == FEATURE_FP16 ? "fp16" : "fp32", store.normalized() ? " normalized" : "",
+           output_file.c_str());
+    return 0;
+}
@@ -17,6 +17,7 @@
 -------------------------------------------*/
 #include <stdio.h>
 #include <stdint.h>
+#include <float.h>
 #include <stdlib.h>
 #include <fstream>
 #include <iostream>
@@ -30,26 +31,40 @@
 #include <sstream>
 #include <algorithm>
 #include <assert.h>
+#include <map>
+#include <thread>
+#include <memory>
 
 #include "opencv2/core/core.hpp"
 #include "opencv2/imgproc.hpp"
 #include "opencv2/imgcodecs.hpp"
 
 #include "rknn_api.h"
+#include "stage_stats.h"
+#include "decode_pool.h"
+#include "tensor_cache.h"
+#include "npu_runner.h"
+#include "image_preprocess.h"
+#include "trace.h"
+#include "dataset_pack.h"
+#include "model_file.h"
+#include "feature_store.h"
+#include "feature_sink.h"
+#include "face_match.h"
 
 using namespace std;
 using namespace cv;
 
+#define DECODE_QUEUE_DEPTH 8
+#define NPU_BENCH_FRAMES 100
+/* features are written in batches of this many images, from a ring of this many buffers. */
+#define FEATURE_SINK_RECORDS 256
+#define FEATURE_SINK_BUFFERS 4
+
 /*-------------------------------------------
                   Functions
 -------------------------------------------*/
 
-static void printRKNNTensor(rknn_tensor_attr *attr) {
-    printf("index=%d name=%s n_dims=%d dims=[%d %d %d %d] n_elems=%d size=%d fmt=%d type=%d qnt_type=%d fl=%d zp=%d scale=%f\n", 
-            attr->index, attr->name, attr->n_dims, attr->dims[3], attr->dims[2], attr->dims[1], attr->dims[0], 
-            attr->n_elems, attr->size, 0, attr->type, attr->qnt_type, attr->fl, attr->zp, attr->scale);
-}
-
 std::vector <std::string> read_directory( const std::string& path = std::string() )
 {
     std::vector <std::string> result;
@@ -76,65 +91,115 @@ std::vector <std::string> read_directory( const std::string& path = std::string(
     return result;
 }
 
-static unsigned char *load_model(const char *filename, int *model_size)
+/* one output tensor of the model, written to the legacy text file or a binary feature store. */
+struct FeatureOutput
 {
-    FILE *fp = fopen(filename, "rb");
-    if(fp == nullptr) {
-        printf("fopen %s fail!\n", filename);
-        return NULL;
-    }
-    fseek(fp, 0, SEEK_END);
-    int model_len = ftell(fp);
-    unsigned char *model = (unsigned char*)malloc(model_len);
-    fseek(fp, 0, SEEK_SET);
-    if(model_len != fread(model, 1, model_len, fp)) {
-        printf("fread %s fail!\n", filename);
-        free(model);
-        return NULL;
-    }
-    *model_size = model_len;
-    if(fp) {
-        fclose(fp);
-    }
-    return model;
+    FeatureOutput() : binary(false), dim(0), text(NULL) {}
+    ~FeatureOutput() { if (text) fclose(text); }
+    bool binary;
+    uint32_t dim;           /* n_elems of the output tensor */
+    std::string path;
+    FILE *text;
+    FeatureStoreWriter store;
+    std::string line;
+};
+
+/* output 0 goes to save_file, further heads (e.g. a quality score) to save_file.<index>. */
+static std::string feature_path(const std::string &save_file, uint32_t output)
+{
+    return output == 0 ? save_file : save_file + "." + std::to_string(output);
 }
 
-static int rknn_GetTop
-    (
-    float *pfProb,
-    float *pfMaxProb,
-    uint32_t *pMaxClass,
-    uint32_t outputCount,
-    uint32_t topNum
-    )
+/* rknn_run times over the run, printed once at the end instead of per image. */
+struct RunSummary
 {
-    uint32_t i, j;
+    RunSummary() : frames(0), total_ms(0), min_ms(FLT_MAX), max_ms(0) {}
+    int frames;
+    double total_ms;
+    float min_ms;
+    float max_ms;
+};
 
-    #define MAX_TOP_NUM 20
-    if (topNum > MAX_TOP_NUM) return 0;
+/* inference thread: check the outputs and copy them into the next sink slot, no formatted I/O unless verbose. */
+static int write_feature(FeatureSink *sink, std::vector<std::unique_ptr<FeatureOutput> > &outputs,
+                         const NpuFrame &frame, int one_pic_repeat_count, bool verbose, RunSummary *summary)
+{
+    if (verbose) {
+        std::cout << "\nRepeat " << one_pic_repeat_count << " times, avg time per run is " << frame.avg_time << " ms\n"<< "max time is " << frame.max_time << " ms, min time is " << frame.min_time << " ms\n";
+        std::cout << "--------------------------------------\n";
+        std::cout << "\n n_output : " << frame.outputs.size() << "\n";
+    }
+    TraceScope trace("write feature", frame.tag);
+    summary->frames++;
+    summary->total_ms += frame.avg_time;
+    summary->min_ms = std::min(summary->min_ms, frame.min_time);
+    summary->max_ms = std::max(summary->max_ms, frame.max_time);
 
-    memset(pfMaxProb, 0, sizeof(float) * topNum);
-    memset(pMaxClass, 0xff, sizeof(float) * topNum);
+    uint8_t *slot = sink->reserve();
+    if (!slot)
+        return -1;
+    for (size_t o = 0; o < outputs.size(); o++)
+    {
+        size_t size = outputs[o]->dim * sizeof(float);
+        // outputs come back as float, the attr size bounds every read
+        if (o >= frame.outputs.size() || frame.outputs[o].size() < size) {
+            printf("output %d: got %d bytes, expected %u floats\n", (int)o,
+                   o < frame.outputs.size() ? (int)frame.outputs[o].size() : 0, outputs[o]->dim);
+            return -1;
+        }
+        memcpy(slot, frame.outputs[o].data(), size);
+        slot += size;
+    }
+    sink->commit();
+    return 0;
+}
 
-    for (j = 0; j < topNum; j++)
+/* writer thread: convert or format a batch of records, then flush it to storage. */
+static int write_features(std::vector<std::unique_ptr<FeatureOutput> > &outputs, const uint8_t *records, size_t count)
+{
+    for (size_t r = 0; r < count; r++)
     {
-        for (i=0; i<outputCount; i++)
+        for (size_t o = 0; o < outputs.size(); o++)
         {
-            if ((i == *(pMaxClass+0)) || (i == *(pMaxClass+1)) || (i == *(pMaxClass+2)) ||
-                (i == *(pMaxClass+3)) || (i == *(pMaxClass+4)))
-            {
+            FeatureOutput *out = outputs[o].get();
+            const float *buffer = (const float *)records;
+            records += out->dim * sizeof(float);
+            if (out->binary) {
+                if (out->store.append(buffer) != 0)
+                    return -1;
                 continue;
             }
 
-            if (pfProb[i] > *(pfMaxProb+j))
+            // text: one line per image, formatted in memory and written at once.
+            // %.8f of -FLT_MAX plus the tab is 50 characters, so no finite or non-finite value is cut
+            char value[64];
+            out->line.clear();
+            for (uint32_t i = 0; i < out->dim; i++)
             {
-                *(pfMaxProb+j) = pfProb[i];
-                *(pMaxClass+j) = i;
+                int n = snprintf(value, sizeof(value), "%.8f\t", buffer[i]);
+                if (n < 0 || n >= (int)sizeof(value)) {
+                    printf("format %s value %g fail!\n", out->path.c_str(), buffer[i]);
+                    return -1;
+                }
+                out->line.append(value, n);
             }
+            out->line += '\n';
+            fwrite(out->line.data(), 1, out->line.size(), out->text);
         }
     }
-
-    return 1;
+    for (size_t o = 0; o < outputs.size(); o++)
+    {
+        FeatureOutput *out = outputs[o].get();
+        if (out->binary) {
+            if (out->store.sync() != 0)
+                return -1;
+        } else if (fflush(out->text) != 0 || fdatasync(fileno(out->text)) != 0) {
+            // text gets the same per batch fdatasync as a binary store
+            printf("write %s fail!\n", out->path.c_str());
+            return -1;
+        }
+    }
+    return 0;
 }
 
 /*-------------------------------------------
@@ -142,19 +207,24 @@ static int rknn_GetTop
 -------------------------------------------*/
 int main(int argc, char** argv)
 {
-    const int MODEL_IN_WIDTH = 112;
-    const int MODEL_IN_HEIGHT = 112;
     const int MODEL_IN_CHANNELS = 3;
     std::string image_dir="./images/val/";
     std::string save_file="./result/result.txt";
     std::string list_name="imageslist.txt";
     int image_count = 0;
     int repeat_count = 500000;
-    rknn_context ctx;
+    int decode_threads = 0;
+    std::string cache_dir;
+    bool async_mode = false;
+    bool zero_copy = false;
+    std::string trace_path;
+    std::string feature_format = "text";
+    FeatureType feature_type = FEATURE_FP32;
+    bool normalize = false;
+    bool verbose = false;
+    std::string pairs_file;
     int ret;
     int res;
-    int model_len = 0;
-    unsigned char *model;
     std::string model_file="./models/AT/SqueezeNet1.0-0000.params";
     int one_pic_repeat_count = 1;
     const char* one_pic_repeat = std::getenv("ONE_PIC_REPEAT_COUNT");
@@ -164,11 +234,11 @@ int main(int argc, char** argv)
     if(argc == 1)
     {
         std::cout << "[Usage]: " << argv[0] << " [-h]\n"
-                  << "[-m model_file] [-i image_dir] [-o save_file] [-l list_name] [-r repeat_count]\n"
+                  << "[-m model_file] [-i image_dir] [-o save_file] [-l list_name] [-r repeat_count] [-j decode_threads] [-c cache_dir] [-a] [-z] [-T trace_file] [-F text|fp32|fp16] [-N] [-V pairs_file] [-v]\n"
                   << " \n";
         return 0;
     }
-    while((res = getopt(argc, argv, "m:i:o:r:l:h")) != -1)
+    while((res = getopt(argc, argv, "m:i:o:r:l:j:c:azT:F:NV:vh")) != -1)
     {
         switch(res)
         {
@@ -187,9 +257,41 @@ int main(int argc, char** argv)
             case 'l':
                 list_name = optarg;
                 break;
+            case 'j':
+                decode_threads = std::strtoul(optarg, NULL, 10);
+                break;
+            case 'c':
+                cache_dir = optarg;
+                break;
+            case 'a':
+                async_mode = true;
+                break;
+            case 'z':
+                zero_copy = true;
+                break;
+            case 'T':
+                trace_path = optarg;
+                trace_enable();
+                break;
+            case 'F':
+                feature_format = optarg;
+                if (feature_format != "text" && parse_feature_type(optarg, &feature_type) < 0) {
+                    printf("unknown feature format %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'N':
+                normalize = true;
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            case 'V':
+                pairs_file = optarg;
+                break;
             case 'h':
                 std::cout << "[Usage]: " << argv[0] << " [-h]\n"
-                          << "[-m model_file] [-i image_dir] [-o save_file] [-r repeat_count]  [-l list_name]\n"
+                          << "[-m model_file] [-i image_dir] [-o save_file] [-r repeat_count]  [-l list_name] [-j decode_threads] [-c cache_dir] [-a] [-z] [-T trace_file] [-F text|fp32|fp16] [-N] [-V pairs_file] [-v]\n"
                           << "\n";
                 return 0;
             default:
@@ -197,46 +299,32 @@ int main(int argc, char** argv)
         }
     }
     // Load RKNN Model
-    model = load_model(model_file.c_str(), &model_len);
-    ret = rknn_init(&ctx, model, model_len, 0);
-    if(ret < 0) {
-        printf("rknn_init fail! ret=%d\n", ret);
+    ModelFile model;
+    if (model.open(model_file) != 0) {
         return -1;
     }
-
-    // Get Model Input Output Info
-    rknn_input_output_num io_num;
-    ret = rknn_query(ctx, RKNN_QUERY_IN_OUT_NUM, &io_num, sizeof(io_num));
-    if (ret != RKNN_SUCC) {
-        printf("rknn_query fail! ret=%d\n", ret);
+    NpuRunner runner;
+    if (runner.init(model.data(), model.size(), async_mode ? RKNN_FLAG_ASYNC_MASK : 0) < 0) {
         return -1;
     }
-    printf("model input num: %d, output num: %d\n", io_num.n_input, io_num.n_output);
-
-    printf("input tensors:\n");
-    rknn_tensor_attr input_attrs[io_num.n_input];
-    memset(input_attrs, 0, sizeof(input_attrs));
-    for (int i = 0; i < io_num.n_input; i++) {
-        input_attrs[i].index = i;
-        ret = rknn_query(ctx, RKNN_QUERY_INPUT_ATTR, &(input_attrs[i]), sizeof(rknn_tensor_attr));
-        if (ret != RKNN_SUCC) {
-            printf("rknn_query fail! ret=%d\n", ret);
-            return -1;
-        }
-        printRKNNTensor(&(input_attrs[i]));
+    // the context holds its own copy, the blob is not needed for the run
+    model.close();
+    runner.set_repeat(one_pic_repeat_count);
+    if (async_mode && one_pic_repeat_count > 1) {
+        printf("async mode runs every image once, ONE_PIC_REPEAT_COUNT ignored\n");
+        one_pic_repeat_count = 1;
     }
-
-    printf("output tensors:\n");
-    rknn_tensor_attr output_attrs[io_num.n_output];
-    memset(output_attrs, 0, sizeof(output_attrs));
-    for (int i = 0; i < io_num.n_output; i++) {
-        output_attrs[i].index = i;
-        ret = rknn_query(ctx, RKNN_QUERY_OUTPUT_ATTR, &(output_attrs[i]), sizeof(rknn_tensor_attr));
-        if (ret != RKNN_SUCC) {
-            printf("rknn_query fail! ret=%d\n", ret);
-            return -1;
+    const rknn_input_output_num &io_num = runner.io_num();
+    // input size from the model, so every face model runs without rebuilding
+    int model_width = 0, model_height = 0;
+    tensor_input_size(&runner.input_attrs()[0], &model_width, &model_height);
+    if (zero_copy) {
+        if (!tensor_accepts_raw_rgb(&runner.input_attrs()[0])) {
+            printf("input tensor is not raw uint8, zero-copy disabled\n");
+            zero_copy = false;
+        } else if (runner.map_input() < 0) {
+            zero_copy = false;
         }
-        printRKNNTensor(&(output_attrs[i]));
     }
 
     // Load image
@@ -250,114 +338,255 @@ int main(int argc, char** argv)
 
 
     std::vector<std::string> img_list;
-    std::ifstream list_stream(list_name);
-    if (!list_stream.is_open())
-    {
-        fprintf(stderr, "Open image list failed.\n");
-        return -1;
-    }
+    // a pack file (rknn_pack_dataset -l list) already holds the list order
+    DatasetPack pack;
+    if (is_dataset_pack(image_dir)) {
+        if (pack.open(image_dir) != 0) {
+            return -1;
+        }
+        img_list = pack.names();
+    } else {
+        std::ifstream list_stream(list_name);
+        if (!list_stream.is_open())
+        {
+            fprintf(stderr, "Open image list failed.\n");
+            return -1;
+        }
 
-    std::string image_name;
-    while (std::getline(list_stream, image_name))
-    {
-        img_list.push_back(image_name);
+        std::string image_name;
+        while (std::getline(list_stream, image_name))
+        {
+            img_list.push_back(image_name);
+        }
     }
 
     // std::vector <std::string> img_list=read_directory(image_dir);
-    std::ofstream feature_file(save_file);
-    for (std::string image :img_list)
-    {
-        image_count = image_count + 1;
-        if (image_count > repeat_count)
-        {
-            image_count=image_count-1;
-            break;
-        }
-        
-        std::cout << "test image count: " << image_count << "\n";
-        image_file=(std::string(image_dir)+std::string(image));
-        std::cout << image_file.c_str() << "\n";
-        cv::Mat orig_img = imread(image_file, cv::IMREAD_COLOR);
-        if(!orig_img.data) {
-            printf("cv::imread %s fail!\n", image_file);
+    if ((int)img_list.size() > repeat_count)
+        img_list.resize(repeat_count);
+
+    TensorCache tensor_cache;
+    if (!cache_dir.empty()) {
+        std::string cache_file = tensor_cache_path(cache_dir, model_width, model_height, MODEL_IN_CHANNELS);
+        if (tensor_cache.open(cache_file, model_width, model_height, MODEL_IN_CHANNELS, img_list) != 0) {
             return -1;
         }
+    }
 
-        cv::Mat img = orig_img.clone();
-        if(orig_img.cols != MODEL_IN_WIDTH || orig_img.rows != MODEL_IN_HEIGHT) {
-            printf("resize %d %d to %d %d\n", orig_img.cols, orig_img.rows, MODEL_IN_WIDTH, MODEL_IN_HEIGHT);
-            cv::resize(orig_img, img, cv::Size(MODEL_IN_WIDTH, MODEL_IN_HEIGHT), (0, 0), (0, 0), cv::INTER_LINEAR);
+    // Decode and preprocess on the pool, infer in list order on this thread
+    BoundedQueue<DecodedImage> decode_queue(DECODE_QUEUE_DEPTH);
+    StageStats decode_stats("decode", decode_threads > 0 ? decode_threads : get_online_cpus());
+    StageStats npu_stats("npu", 1);
+    StageStats write_stats("write", 1);
+    DecodePool decode_pool(decode_threads, &decode_queue, &decode_stats);
+    decode_pool.set_transform([&](DecodedImage &item) {
+        // zero-copy: resized straight into the mapped input before the run
+        if (zero_copy)
+            return;
+        cv::Mat img(model_height, model_width, CV_8UC3);
+        {
+            TraceScope trace("preprocess_to_tensor", item.index);
+            preprocess_to_tensor(item.img, item.rgb, model_width, model_height, RKNN_TENSOR_NHWC, img.data);
         }
+        item.img = img;
+        item.rgb = true;
+        tensor_cache.put(item.index, item.img.data);
+    });
+    printf("decode threads: %d\n", decode_pool.threads());
+    int64_t start_us = get_time_us();
+    decode_pool.start();
+    std::thread feeder([&]() {
+        for (size_t n = 0; n < img_list.size(); n++)
+        {
+            // cached tensors bypass the pool
+            const uint8_t *tensor = tensor_cache.get(n);
+            if (tensor) {
+                DecodedImage item;
+                item.index = n;
+                item.name = img_list[n];
+                item.img = cv::Mat(model_height, model_width, CV_8UC3, (void *)tensor);
+                item.rgb = true;
+                if (!decode_queue.push(std::move(item)))
+                    break;
+                continue;
+            }
+            DecodeJob job;
+            job.index = n;
+            job.name = img_list[n];
+            job.path = image_dir + img_list[n];
+            if (pack.is_open())
+                job.mapped = pack.data(n, &job.mapped_size);
+            if (!decode_pool.submit(std::move(job)))
+                break;
+        }
+        decode_pool.finish();
+        decode_queue.close();
+    });
 
-        cv::cvtColor(img, img, COLOR_BGR2RGB);
-        // Set Input Data
-        rknn_input inputs[1];
-        memset(inputs, 0, sizeof(inputs));
-        inputs[0].index = 0;
-        inputs[0].type = RKNN_TENSOR_UINT8;
-        inputs[0].size = img.cols*img.rows*img.channels();
-        inputs[0].fmt = RKNN_TENSOR_NHWC;
-        inputs[0].buf = img.data;
-
-        ret = rknn_inputs_set(ctx, io_num.n_input, inputs);
-        if(ret < 0) {
-            printf("rknn_input_set fail! ret=%d\n", ret);
-            return -1;
+    trace_thread_name("npu");
+    std::map<int, DecodedImage> reorder;
+    RunSummary run_summary;
+    int status = 0;
+    // one file per output, sized from the output attributes
+    std::vector<std::unique_ptr<FeatureOutput> > feature_file;
+    if (feature_format == "text" && normalize)
+        printf("-N applies to binary feature stores only\n");
+    if (feature_format == "text" && !pairs_file.empty()) {
+        printf("-V scores a binary feature store, use -F fp32 or -F fp16\n");
+        pairs_file.clear();
+    }
+    for (uint32_t i = 0; i < io_num.n_output && status == 0; i++) {
+        FeatureOutput *out = new FeatureOutput();
+        feature_file.push_back(std::unique_ptr<FeatureOutput>(out));
+        out->binary = feature_format != "text";
+        out->dim = runner.output_attrs()[i].n_elems;
+        out->path = feature_path(save_file, i);
+        printf("output %d: %u values -> %s\n", i, out->dim, out->path.c_str());
+        if (out->binary) {
+            if (out->store.open(out->path, out->dim, feature_type, normalize) != 0)
+                status = -1;
+        } else {
+            out->text = fopen(out->path.c_str(), "w");
+            if (out->text == NULL) {
+                printf("open %s fail!\n", out->path.c_str());
+                status = -1;
+            }
         }
-        struct timeval t0, t1;
-        float avg_time = 0.f;
-        float min_time = __DBL_MAX__;
-        float max_time = -__DBL_MAX__;
-        for (int e = 0 ; e < one_pic_repeat_count; e++)
+    }
+    // the npu loop only copies outputs into the sink, a writer thread does the I/O
+    size_t record_size = 0;
+    for (size_t i = 0; i < feature_file.size(); i++)
+        record_size += feature_file[i]->dim * sizeof(float);
+    FeatureSink sink;
+    if (status == 0 && sink.start(record_size, FEATURE_SINK_RECORDS, FEATURE_SINK_BUFFERS,
+                                  [&](const uint8_t *records, size_t count) {
+                                      return write_features(feature_file, records, count);
+                                  }) != 0) {
+        status = -1;
+    }
+    while (status == 0 && image_count < (int)img_list.size())
+    {
+        std::map<int, DecodedImage>::iterator it = reorder.find(image_count);
+        if (it == reorder.end())
         {
-            gettimeofday(&t0, NULL);
-            // Run
-            printf("rknn_run\n");
-            ret = rknn_run(ctx, nullptr);
-            gettimeofday(&t1, NULL);
-            if(ret < 0) {
-                printf("rknn_run fail! ret=%d\n", ret);
-                return -1;
+            DecodedImage item;
+            if (!decode_queue.pop(item)) {
+                status = -1;
+                break;
             }
+            reorder[item.index] = std::move(item);
+            continue;
+        }
+        DecodedImage decoded = std::move(it->second);
+        reorder.erase(it);
+        image_count = image_count + 1;
 
-            float mytime = ( float )((t1.tv_sec * 1000000 + t1.tv_usec) - (t0.tv_sec * 1000000 + t0.tv_usec)) / 1000;
-            avg_time += mytime;
-            min_time = std::min(min_time, mytime);
-            max_time = std::max(max_time, mytime);
+        image_file=(std::string(image_dir)+decoded.name);
+        if (verbose) {
+            std::cout << "test image count: " << image_count << "\n";
+            std::cout << image_file.c_str() << "\n";
         }
-        std::cout << "\nRepeat " << one_pic_repeat_count << " times, avg time per run is " << avg_time / one_pic_repeat_count << " ms\n"<< "max time is " << max_time << " ms, min time is " << min_time << " ms\n";
-        std::cout << "--------------------------------------\n";
-        // Get Output
-        rknn_output outputs[1];
-        memset(outputs, 0, sizeof(outputs));
-        outputs[0].want_float = 1;
-        ret = rknn_outputs_get(ctx, 1, outputs, NULL);
+        if(!decoded.img.data) {
+            printf("cv::imread %s fail!\n", image_file.c_str());
+            status = -1;
+            break;
+        }
+
+        cv::Mat img = decoded.img;
+        NpuFrame frame;
+        int64_t t0 = get_time_us();
+        if (zero_copy) {
+            {
+                TraceScope trace("preprocess_to_tensor", decoded.index);
+                preprocess_to_tensor(img, decoded.rgb, model_width, model_height,
+                                     runner.input_attrs()[0].fmt, runner.mapped_input());
+            }
+            if (!decoded.rgb && runner.input_attrs()[0].fmt == RKNN_TENSOR_NHWC)
+                tensor_cache.put(decoded.index, runner.mapped_input());
+            ret = runner.run_mapped(decoded.index, &frame);
+        } else {
+            ret = runner.run(decoded.index, img.data, img.total() * img.elemSize(), &frame);
+        }
+        npu_stats.add(get_time_us() - t0);
         if(ret < 0) {
-            printf("rknn_outputs_get fail! ret=%d\n", ret);
-            return -1;
+            status = -1;
+            break;
         }
-        // write feature to file
-        char format_string[16] = { 0 };
-        std::cout << "\n n_output : " << io_num.n_output << "\n";
-        
-        float *buffer = (float *)outputs[0].buf;
-        for (int i = 0; i < 512; i++)
-        {
-            memset(format_string, 0, 16);
-            sprintf(format_string, "%.8f\t", buffer[i]);
-            feature_file.write(format_string, strlen(format_string));
+        // in async mode this is the previous image, still in list order
+        if (ret > 0) {
+            t0 = get_time_us();
+            if (write_feature(&sink, feature_file, frame, one_pic_repeat_count, verbose, &run_summary) != 0) {
+                status = -1;
+                break;
+            }
+            write_stats.add(get_time_us() - t0);
         }
-        feature_file.write("\n", 1);
-        // Release rknn_outputs
-        rknn_outputs_release(ctx, 1, outputs);
-    } 
-    feature_file.close();
-    // Release
-    if(ctx >= 0) {
-        rknn_destroy(ctx);
     }
-    if(model) {
-        free(model);
+    // async mode: collect the frames still on the npu
+    while (status == 0 && runner.pending() > 0)
+    {
+        NpuFrame frame;
+        ret = runner.flush(&frame);
+        if (ret < 0) {
+            status = -1;
+        }
+        if (ret <= 0) {
+            break;
+        }
+        int64_t t0 = get_time_us();
+        if (write_feature(&sink, feature_file, frame, one_pic_repeat_count, verbose, &run_summary) != 0) {
+            status = -1;
+            break;
+        }
+        write_stats.add(get_time_us() - t0);
     }
-    return 0;
+    if (sink.finish() != 0)
+        status = -1;
+    if (run_summary.frames > 0) {
+        printf("features: %d images, rknn_run avg %.2f ms, min %.2f ms, max %.2f ms (repeat %d)\n", run_summary.frames,
+               run_summary.total_ms / run_summary.frames, run_summary.min_ms, run_summary.max_ms, one_pic_repeat_count);
+    }
+    for (size_t i = 0; i < feature_file.size(); i++) {
+        FeatureOutput *out = feature_file[i].get();
+        if (!out->binary) {
+            if (out->text && fclose(out->text) != 0)
+                status = -1;
+            out->text = NULL;
+        } else if (out->store.close() != 0) {
+            status = -1;
+        } else {
+            printf("feature store %s: %llu x %u %s\n", out->path.c_str(), (unsigned long long)out->store.count(),
+                   out->dim, feature_format.c_str());
+        }
+    }
+    if (status < 0) {
+        decode_pool.cancel();
+        decode_queue.close();
+    }
+    feeder.join();
+    if (!trace_path.empty())
+        trace_write(trace_path);
+    std::vector<StageStats *> stages;
+    stages.push_back(&decode_stats);
+    stages.push_back(&npu_stats);
+    stages.push_back(&write_stats);
+    print_stage_report(stages, get_time_us() - start_us);
+    runner.print_report();
+    sink.print_report();
+    decode_pool.print_report();
+    tensor_cache.print_report();
+    // Release
+    runner.release();
+    // 1:1 verification on the board, over the store just written
+    if (status == 0 && !pairs_file.empty() &&
+        verify_store(feature_path(save_file, 0), img_list, pairs_file, "") != 0)
+        status = -1;
+    // the benchmark creates fresh contexts, map the model again for it
+    if (async_mode && status == 0 && model.open(model_file) == 0) {
+        // same model, blank input: isolates the npu submission mode
+        float sync_fps = npu_benchmark_fps(model.data(), model.size(), 0, NPU_BENCH_FRAMES);
+        float async_fps = npu_benchmark_fps(model.data(), model.size(), RKNN_FLAG_ASYNC_MASK, NPU_BENCH_FRAMES);
+        printf("npu throughput over %d frames: sync %.2f fps, async %.2f fps, gain %.1f%%\n",
+               NPU_BENCH_FRAMES, sync_fps, async_fps, sync_fps > 0 ? (async_fps / sync_fps - 1) * 100 : 0.f);
+    }
+    return status;
 }
@@ -0,0 +1,171 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*-------------------------------------------
+                Includes
+-------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "dataset_pack.h"
+#include "label_index.h"
+
+/*-------------------------------------------
+                  Functions
+-------------------------------------------*/
+
+std::vector <std::string> read_directory( const std::string& path = std::string() )
+{
+    std::vector <std::string> result;
+    dirent* de;
+    DIR* dp;
+    dp = opendir( path.empty() ? "." : path.c_str() );
+    if (dp)
+    {
+        while (true)
+        {
+            de = readdir( dp );
+            if (de == NULL) break;
+            if (strcmp(".", de->d_name) == 0 || strcmp("..", de->d_name) == 0)
+                continue;
+            if (std::string( de->d_name ).find(".JPEG") == std::string::npos && std::string( de->d_name ).find(".jpg") == std::string::npos)
+                continue;
+            result.push_back( std::string( de->d_name ) );
+        }
+        closedir( dp );
+        std::sort( result.begin(), result.end() );
+    }
+    return result;
+}
+
+static bool read_whole_file(const std::string &filename, std::vector<uint8_t> &data)
+{
+    FILE *fp = fopen(filename.c_str(), "rb");
+    if (fp == NULL)
+        return false;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    data.resize(size > 0 ? size : 0);
+    bool ok = size > 0 && fread(data.data(), 1, size, fp) == (size_t)size;
+    fclose(fp);
+    return ok;
+}
+
+/*-------------------------------------------
+                  Main Function
+-------------------------------------------*/
+int main(int argc, char** argv)
+{
+    std::string image_dir = "./images/val/";
+    std::string list_name;
+    std::string val_file;
+    std::string pack_file = "dataset.pack";
+    int res;
+
+    if(argc == 1)
+    {
+        std::cout << "[Usage]: " << argv[0] << " [-h]\n"
+                  << "[-i image_dir] [-l list_name] [-v val_file] [-o pack_file]\n"
+                  << " \n";
+        return 0;
+    }
+    while((res = getopt(argc, argv, "i:l:v:o:h")) != -1)
+    {
+        switch(res)
+        {
+            case 'i':
+                image_dir = optarg;
+                break;
+            case 'l':
+                list_name = optarg;
+                break;
+            case 'v':
+                val_file = optarg;
+                break;
+            case 'o':
+                pack_file = optarg;
+                break;
+            case 'h':
+                std::cout << "[Usage]: " << argv[0] << " [-h]\n"
+                          << "[-i image_dir] [-l list_name] [-v val_file] [-o pack_file]\n"
+                          << "\n";
+                return 0;
+            default:
+                break;
+        }
+    }
+    if (!image_dir.empty() && image_dir[image_dir.size() - 1] != '/')
+        image_dir += '/';
+
+    // images in list order, or the sorted directory like the classification demo
+    std::vector<std::string> img_list;
+    if (!list_name.empty()) {
+        std::ifstream list_stream(list_name);
+        if (!list_stream.is_open()) {
+            printf("open %s fail!\n", list_name.c_str());
+            return -1;
+        }
+        std::string image_name;
+        while (std::getline(list_stream, image_name)) {
+            if (!image_name.empty())
+                img_list.push_back(image_name);
+        }
+    } else {
+        img_list = read_directory(image_dir);
+    }
+
+    LabelIndex labels;
+    if (!val_file.empty() && labels.open(val_file) != 0) {
+        return -1;
+    }
+
+    DatasetPackWriter writer;
+    if (writer.open(pack_file) != 0) {
+        return -1;
+    }
+    std::vector<uint8_t> data;
+    size_t total = 0;
+    int unlabeled = 0;
+    for (size_t i = 0; i < img_list.size(); i++)
+    {
+        std::string path = image_dir + img_list[i];
+        if (!read_whole_file(path, data)) {
+            printf("read %s fail!\n", path.c_str());
+            return -1;
+        }
+        int label = labels.find(img_list[i]);
+        if (label < 0)
+            unlabeled++;
+        if (writer.add(img_list[i], label, data.data(), data.size()) != 0) {
+            return -1;
+        }
+        total += data.size();
+    }
+    if (writer.finish() != 0) {
+        return -1;
+    }
+    printf("packed %d images, %.1f MB into %s\n", (int)img_list.size(), total / 1048576.0, pack_file.c_str());
+    if (!val_file.empty() && unlabeled)
+        printf("%d images have no label in %s\n", unlabeled, val_file.c_str());
+    return 0;
+}
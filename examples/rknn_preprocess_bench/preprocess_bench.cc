@@ -0,0 +1,150 @@
+// Copyright (c) 2021 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*-------------------------------------------
+                Includes
+-------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/imgcodecs.hpp"
+#include "opencv2/imgproc.hpp"
+
+#include "image_preprocess.h"
+#include "stage_stats.h"
+
+using namespace cv;
+
+/*-------------------------------------------
+                  Functions
+-------------------------------------------*/
+
+/* the sequence the demos used before preprocess_to_tensor: resize, cvtColor, split for NCHW. */
+static void opencv_preprocess(const Mat &src, int width, int height, rknn_tensor_format fmt, uint8_t *dst)
+{
+    Mat resized;
+    resize(src, resized, Size(width, height), 0, 0, INTER_LINEAR);
+    if (fmt == RKNN_TENSOR_NHWC) {
+        Mat out(height, width, CV_8UC3, dst);
+        cvtColor(resized, out, COLOR_BGR2RGB);
+        return;
+    }
+    Mat rgb;
+    cvtColor(resized, rgb, COLOR_BGR2RGB);
+    size_t plane = (size_t)width * height;
+    std::vector<Mat> planes(3);
+    for (int c = 0; c < 3; c++)
+        planes[c] = Mat(height, width, CV_8UC1, dst + c * plane);
+    split(rgb, planes);
+}
+
+static double bench(const Mat &src, int width, int height, rknn_tensor_format fmt, uint8_t *dst,
+                    int iterations, bool fused)
+{
+    int64_t t0 = get_time_us();
+    for (int i = 0; i < iterations; i++)
+    {
+        if (fused)
+            preprocess_to_tensor(src, false, width, height, fmt, dst);
+        else
+            opencv_preprocess(src, width, height, fmt, dst);
+    }
+    return (double)(get_time_us() - t0) / iterations;
+}
+
+/*-------------------------------------------
+                  Main Function
+-------------------------------------------*/
+int main(int argc, char** argv)
+{
+    std::string image_file;
+    int width = 224;
+    int height = 224;
+    int iterations = 1000;
+    rknn_tensor_format fmt = RKNN_TENSOR_NHWC;
+    int res;
+    while((res = getopt(argc, argv, "i:s:n:ch")) != -1)
+    {
+        switch(res)
+        {
+            case 'i':
+                image_file = optarg;
+                break;
+            case 's':
+                if (sscanf(optarg, "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) {
+                    printf("invalid size %s, expected WxH\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'n':
+                iterations = atoi(optarg);
+                break;
+            case 'c':
+                fmt = RKNN_TENSOR_NCHW;
+                break;
+            case 'h':
+            default:
+                std::cout << "[Usage]: " << argv[0] << " [-i image_file] [-s WxH] [-n iterations] [-c]\n"
+                          << "  -i  BGR source image, default a random 500x375 image\n"
+                          << "  -s  output size, default 224x224\n"
+                          << "  -n  iterations per variant, default 1000\n"
+                          << "  -c  NCHW output instead of NHWC\n"
+                          << " \n";
+                return 0;
+        }
+    }
+    if (iterations <= 0)
+        iterations = 1;
+
+    Mat src;
+    if (!image_file.empty()) {
+        src = imread(image_file, IMREAD_COLOR);
+        if (!src.data) {
+            printf("cv::imread %s fail!\n", image_file.c_str());
+            return -1;
+        }
+    } else {
+        src = Mat(375, 500, CV_8UC3);
+        randu(src, Scalar::all(0), Scalar::all(255));
+    }
+
+    size_t size = (size_t)width * height * 3;
+    std::vector<uint8_t> ref(size), out(size);
+    opencv_preprocess(src, width, height, fmt, ref.data());
+    preprocess_to_tensor(src, false, width, height, fmt, out.data());
+    int max_diff = 0;
+    size_t diff_count = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+        int d = abs((int)ref[i] - (int)out[i]);
+        if (d > max_diff)
+            max_diff = d;
+        diff_count += d != 0;
+    }
+
+    double opencv_us = bench(src, width, height, fmt, ref.data(), iterations, false);
+    double fused_us = bench(src, width, height, fmt, out.data(), iterations, true);
+
+    printf("%dx%d -> %dx%d %s, %d iterations\n", src.cols, src.rows, width, height,
+           fmt == RKNN_TENSOR_NCHW ? "NCHW" : "NHWC", iterations);
+    printf("opencv resize+cvtColor%s: %.1f us\n", fmt == RKNN_TENSOR_NCHW ? "+split" : "", opencv_us);
+    printf("fused preprocess_to_tensor: %.1f us (%.2fx)\n", fused_us, opencv_us / fused_us);
+    printf("max diff %d, %.2f%% of values differ\n", max_diff, 100.0 * diff_count / size);
+    return 0;
+}
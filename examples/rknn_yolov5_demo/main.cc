@@ -31,6 +31,7 @@
 #include "rga_func.h"
 #include "rknn_api.h"
 #include "postprocess.h"
+#include "model_file.h"
 
 #define PERF_WITH_POST 1
 /*-------------------------------------------
@@ -47,59 +48,6 @@ static void printRKNNTensor(rknn_tensor_attr *attr)
 }
 double __get_us(struct timeval t) { return (t.tv_sec * 1000000 + t.tv_usec); }
 
-static unsigned char *load_data(FILE *fp, size_t ofst, size_t sz)
-{
-    unsigned char *data;
-    int ret;
-
-    data = NULL;
-
-    if (NULL == fp)
-    {
-        return NULL;
-    }
-
-    ret = fseek(fp, ofst, SEEK_SET);
-    if (ret != 0)
-    {
-        printf("blob seek failure.\n");
-        return NULL;
-    }
-
-    data = (unsigned char *)malloc(sz);
-    if (data == NULL)
-    {
-        printf("buffer malloc failure.\n");
-        return NULL;
-    }
-    ret = fread(data, 1, sz, fp);
-    return data;
-}
-
-static unsigned char *load_model(const char *filename, int *model_size)
-{
-
-    FILE *fp;
-    unsigned char *data;
-
-    fp = fopen(filename, "rb");
-    if (NULL == fp)
-    {
-        printf("Open file %s failed.\n", filename);
-        return NULL;
-    }
-
-    fseek(fp, 0, SEEK_END);
-    int size = ftell(fp);
-
-    data = load_data(fp, 0, size);
-
-    fclose(fp);
-
-    *model_size = size;
-    return data;
-}
-
 static int saveFloat(const char *file_name, float *output, int element_size)
 {
     FILE *fp;
@@ -160,14 +108,22 @@ int main(int argc, char **argv)
 
     /* Create the neural network */
     printf("Loading mode...\n");
-    int model_data_size = 0;
-    unsigned char *model_data = load_model(model_name, &model_data_size);
-    ret = rknn_init(&ctx, model_data, model_data_size, 0);
+    ModelFile model;
+    if (model.open(model_name) != 0)
+    {
+        return -1;
+    }
+    gettimeofday(&start_time, NULL);
+    ret = rknn_init(&ctx, model.data(), model.size(), 0);
+    gettimeofday(&stop_time, NULL);
     if (ret < 0)
     {
         printf("rknn_init error ret=%d\n", ret);
         return -1;
     }
+    printf("rknn_init use %f ms\n", (__get_us(stop_time) - __get_us(start_time)) / 1000);
+    // the context holds its own copy of the model
+    model.close();
 
     rknn_sdk_version version;
     ret = rknn_query(ctx, RKNN_QUERY_SDK_VERSION, &version,
@@ -328,11 +284,6 @@ int main(int argc, char **argv)
 
     drm_deinit(&drm_ctx, drm_fd);
     RGA_deinit(&rga_ctx);
-    if (model_data)
-    {
-        free(model_data);
-    }
-
     if (resize_buf)
     {
         free(resize_buf);